@@ -28,7 +28,7 @@ namespace arch {
 		}
 
 		base::archive::ptr archive{};
-		auto const result = open(std::move(file), archive);
+		auto const result = open(std::move(file), archive, format_hint{path});
 		switch (result) {
 			case open_status::compression_damaged:
 				unp.on_error(path, "file compression damaged");
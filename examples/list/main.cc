@@ -54,7 +54,7 @@ namespace arch {
 		if (!file) return error(path, "file not found");
 
 		base::archive::ptr archive{};
-		auto const result = open(std::move(file), archive);
+		auto const result = open(std::move(file), archive, format_hint{path});
 		switch (result) {
 			case open_status::compression_damaged:
 				return error(path, "file compression damaged");
@@ -4,6 +4,8 @@
 #pragma once
 
 #include <arch/base/archive.hh>
+#include <span>
+#include <string>
 #include <string_view>
 #include <vector>
 
@@ -15,6 +17,57 @@ namespace arch {
 		archive_unknown
 	};
 
-	open_status open(io::seekable::ptr file, base::archive::ptr& archive);
+	// A compression layer open() can take off, before it looks at what is
+	// inside.
+	struct filter_info {
+		struct extension {
+			std::string suffix{};
+			// the decoded file would be named with this instead of the
+			// suffix, e.g. "tar" for "tgz"
+			std::string inner{};
+		};
+
+		std::string name{};
+		std::vector<extension> extensions{};
+		bool (*is_valid)(std::span<std::byte const> prefix){};
+		io::seekable::ptr (*wrap)(io::seekable::ptr&& file,
+		                          open_options const& opts){};
+	};
+
+	struct archive_info {
+		std::string name{};
+		std::vector<std::string> extensions{};
+		bool (*is_valid)(std::span<std::byte const> prefix){};
+		base::archive::ptr (*open)(io::seekable::ptr&& file,
+		                           open_options const& opts){};
+		// Optional, for the archives the prefix is not enough for. Leaves
+		// the file with the caller, if it is not one of them.
+		base::archive::ptr (*probe)(io::seekable::ptr& file,
+		                            open_options const& opts){};
+		// Usually found inside a filter; known_extentions() then lists it
+		// with the suffix of each filter, too, e.g. "tar.gz".
+		bool filterable{false};
+	};
+
+	// Formats registered by the application are tried after the built-in
+	// ones, in the order of registration. The prefix given to is_valid()
+	// holds the first 512 bytes of the file, or all of it, if shorter.
+	void register_filter(filter_info const& info);
+	void register_archive(archive_info const& info);
+
+	struct format_hint {
+		// the formats claiming an extension of this name are tried first
+		fs::path filename{};
+		// ...and no other formats are tried at all
+		bool exclusive{false};
+	};
+
+	open_status open(io::seekable::ptr file,
+	                 base::archive::ptr& archive,
+	                 open_options const& opts = {});
+	open_status open(io::seekable::ptr file,
+	                 base::archive::ptr& archive,
+	                 format_hint const& hint,
+	                 open_options const& opts = {});
 	std::vector<std::string_view> known_extentions();
 }  // namespace arch
@@ -6,14 +6,19 @@
 #include <arch/base/entry.hh>
 #include <arch/base/fs.hh>
 #include <arch/base/io/seekable.hh>
+#include <arch/base/options.hh>
+#include <string_view>
 
 namespace arch::base {
 	struct archive {
 		virtual ~archive();
-		virtual bool open(io::seekable::ptr) = 0;
+		virtual bool open(io::seekable::ptr, open_options const&) = 0;
 		virtual void close() = 0;
 		virtual size_t count() const = 0;
 		virtual base::entry::ptr entry(size_t) const = 0;
+		// The first member listed under this name, or null. Archives read
+		// as they go stop at that member, ready to read it with no rewind.
+		virtual base::entry::ptr find(std::string_view name) const;
 
 		using ptr = std::unique_ptr<archive>;
 	};
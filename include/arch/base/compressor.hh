@@ -0,0 +1,40 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <span>
+
+namespace arch::base {
+	enum class flush_mode {
+		// encoder decides, when to emit output
+		none,
+		// everything consumed so far is emitted and can be decoded
+		sync,
+		// ends the stream
+		finish,
+	};
+
+	struct compressor {
+		virtual ~compressor();
+		virtual bool finished() const noexcept = 0;
+		virtual bool failed() const noexcept = 0;
+		// returns {produced, consumed}; a flush is complete, when a call
+		// with no input left some room in the output (or, for finish, when
+		// finished() becomes true)
+		virtual std::pair<size_t, size_t> compress(
+		    std::span<std::byte const> input,
+		    std::span<std::byte> output,
+		    flush_mode mode) = 0;
+		// prepares the encoder for the next stream, if it can be done
+		// cheaper, than creating a new one
+		virtual bool reset() noexcept;
+		// changes the level for the input given after this call, if the
+		// encoder is able to do it in the middle of a stream
+		virtual bool set_level(int level) noexcept;
+
+		using ptr = std::unique_ptr<compressor>;
+	};
+}  // namespace arch::base
@@ -11,9 +11,13 @@ namespace arch::base {
 	struct decompressor {
 		virtual ~decompressor();
 		virtual bool eof() const noexcept = 0;
+		virtual bool damaged() const noexcept = 0;
 		virtual std::pair<size_t, size_t> decompress(
 		    std::span<std::byte> input,
 		    std::span<std::byte> output) = 0;
+		// prepares the decoder for the next stream/frame, if it can be done
+		// cheaper, than creating a new one
+		virtual bool reset() noexcept;
 
 		using ptr = std::unique_ptr<decompressor>;
 	};
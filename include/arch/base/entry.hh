@@ -5,6 +5,7 @@
 
 #include <arch/base/fs.hh>
 #include <arch/base/io/stream.hh>
+#include <vector>
 
 namespace arch::base {
 	struct entry {
@@ -15,6 +16,12 @@ namespace arch::base {
 		virtual io::status const& linked_status() const = 0;
 		virtual fs::path const& linkname() const = 0;
 
+		// Decodes the whole entry in one call; the output must be exactly
+		// file_status().size long. With verify::background there is no later
+		// moment to report a mismatch, so the checksum is compared inline.
+		virtual bool read_into(std::span<std::byte> output) const;
+		bool read_all(std::vector<std::byte>& output) const;
+
 		using ptr = std::unique_ptr<entry>;
 	};
 
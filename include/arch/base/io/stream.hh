@@ -4,6 +4,7 @@
 #pragma once
 
 #include <arch/base/fs.hh>
+#include <arch/base/verify.hh>
 #include <cstdint>
 #include <memory>
 #include <span>
@@ -28,6 +29,12 @@ namespace arch::base::io {
 		    std::chrono::system_clock::from_time_t(last_write_time));
 	}
 
+	// region of a sparse file, which holds the data
+	struct extent {
+		uintmax_t offset{};
+		uintmax_t size{};
+	};
+
 	struct stream {
 		stream();
 		virtual ~stream();
@@ -37,6 +44,14 @@ namespace arch::base::io {
 		virtual io::status const& linked_status() const = 0;
 		virtual fs::path const& linkname() const = 0;
 		virtual std::size_t read(std::span<std::byte>);
+		virtual verify_result verification();
+
+		// Data regions of a sparse file, in order, with the last one ending
+		// at the end of the file; the rest of the file reads as zeros.
+		// Empty for the files stored in full.
+		virtual std::span<extent const> sparse_map() const;
+		// Moves past the next bytes, without reading them from a hole
+		virtual std::size_t skip(std::size_t length);
 
 		using ptr = std::unique_ptr<stream>;
 	};
@@ -84,6 +99,7 @@ namespace arch::base::io {
 namespace arch::io {
 	using base::io::dos_status_mixin;
 	using base::io::dos_stream_mixin;
+	using base::io::extent;
 	using base::io::status;
 	using base::io::status_mixin;
 	using base::io::stream;
@@ -0,0 +1,24 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <arch/base/fs.hh>
+#include <arch/base/verify.hh>
+
+namespace arch::base {
+	struct open_options {
+		verify integrity{default_verify()};
+		// zip: compare the central directory with the rest of the file;
+		// trusted inputs can skip it and open faster
+		bool check_consistency{true};
+		// tar: once all the headers are read, they are kept in a catalog
+		// in this directory; the next open of the same, unchanged file
+		// reads the catalog instead. Empty keeps no catalogs.
+		fs::path catalog_dir{};
+	};
+}  // namespace arch::base
+
+namespace arch {
+	using base::open_options;
+}  // namespace arch
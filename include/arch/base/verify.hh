@@ -0,0 +1,39 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+namespace arch::base {
+	// How the filters and archives check the checksums stored alongside the
+	// compressed data (gzip and zip CRC32, xz/bzip2 stream checks).
+	enum class verify {
+		// check each member as soon as its trailer is read and stop decoding
+		// on the first mismatch
+		immediate,
+		// hand the decoded data over to a worker thread; failures are visible
+		// through stream::verification() once all of it was checked
+		background,
+		// compute the checksums while decoding, but never stop reading;
+		// failures are only visible through stream::verification()
+		at_end,
+		// the input was produced by us, do not compute anything
+		trusted,
+	};
+
+	enum class verify_result {
+		// nothing was compared yet, or the checks were skipped
+		unchecked,
+		// at least one checksum was compared and all of them matched
+		valid,
+		// a checksum did not match or the decoder found the data corrupted
+		damaged,
+	};
+
+	verify default_verify() noexcept;
+	void set_default_verify(verify) noexcept;
+}  // namespace arch::base
+
+namespace arch {
+	using base::verify;
+	using base::verify_result;
+}  // namespace arch
@@ -8,6 +8,7 @@
 #undef min
 #undef max
 #endif
+#include <arch/base/compressor.hh>
 #include <arch/base/decompressor.hh>
 
 namespace arch::bzlib {
@@ -16,11 +17,31 @@ namespace arch::bzlib {
 		decompressor();
 		~decompressor();
 		bool eof() const noexcept final { return eof_; }
+		bool damaged() const noexcept final { return damaged_; }
 		std::pair<size_t, size_t> decompress(std::span<std::byte> input,
 		                                     std::span<std::byte> output) final;
 
 	private:
 		bool eof_{false};
+		bool damaged_{false};
+		int is_initialised_{false};
+		bz_stream bz_{};
+	};
+
+	class compressor final : public base::compressor {
+	public:
+		// level is the block size, in 100k units (1-9)
+		explicit compressor(int level = 9);
+		~compressor();
+		bool finished() const noexcept final { return finished_; }
+		bool failed() const noexcept final { return failed_; }
+		std::pair<size_t, size_t> compress(std::span<std::byte const> input,
+		                                   std::span<std::byte> output,
+		                                   base::flush_mode mode) final;
+
+	private:
+		bool finished_{false};
+		bool failed_{false};
 		int is_initialised_{false};
 		bz_stream bz_{};
 	};
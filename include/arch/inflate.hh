@@ -0,0 +1,46 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <arch/base/decompressor.hh>
+#include <span>
+#include <string_view>
+
+namespace arch::inflate {
+	// Implementation of raw deflate decoding used by io::gzip and zip
+	// entries. Besides stock zlib, the library can be built with zlib-ng,
+	// ISA-L and libdeflate (see LIBARCH_WITH_* CMake options); all of them
+	// produce identical output.
+	struct backend {
+		std::string_view name;
+		bool (*supported)() noexcept;
+		// streaming decoder; null for libraries, which can only decode
+		// whole buffers
+		base::decompressor::ptr (*make)();
+		// decodes one complete stream into output of exactly known size;
+		// used receives the size of the stream found in the input
+		bool (*decode_all)(std::span<std::byte const> input,
+		                   std::span<std::byte> output,
+		                   size_t& used);
+	};
+
+	// Backends compiled into the library, in order of preference.
+	std::span<backend const> backends() noexcept;
+	backend const* find(std::string_view name) noexcept;
+
+	// Selects a backend by name, "auto" (or empty name) brings back the
+	// default choice, which is either the value of LIBARCH_INFLATE
+	// environment variable, or the first supported backend on this CPU.
+	// Selecting a buffer-only backend leaves the streaming choice alone.
+	// Returns false and leaves the selection unchanged, if the backend is
+	// not compiled in, or not supported here.
+	bool select(std::string_view name) noexcept;
+	backend const& selected() noexcept;
+	backend const& selected_for_buffers() noexcept;
+
+	base::decompressor::ptr make_decompressor();
+	bool decode_all(std::span<std::byte const> input,
+	                std::span<std::byte> output,
+	                size_t& used);
+}  // namespace arch::inflate
@@ -5,6 +5,7 @@
 
 #include <arch/base/decompressor.hh>
 #include <arch/base/io/seekable.hh>
+#include <arch/base/options.hh>
 #include <vector>
 
 namespace arch::io {
@@ -15,31 +16,32 @@ namespace arch::io {
 		io::status const& linked_status() const final;
 		fs::path const& linkname() const final;
 		std::size_t read(std::span<std::byte>) override;
-		std::size_t seek(std::size_t pos) final;
-		std::size_t seek_end() final;
+		std::size_t seek(std::size_t pos) override;
+		std::size_t seek_end() override;
 		std::size_t tell() const final;
+		verify_result verification() override;
 
 	protected:
 		template <typename Final, typename... Args>
 		static io::seekable::ptr wrap_impl(io::seekable::ptr&& file,
+		                                   open_options const& opts,
 		                                   Args&&... args) {
 			if (!file) return {};
 
 			auto stream = std::make_unique<Final>(std::forward<Args>(args)...);
-			stream->set_file(std::move(file));
+			stream->set_file(std::move(file), opts.integrity);
 			return stream;
 		}
 
-		void set_file(io::seekable::ptr&& file) {
+		void set_file(io::seekable::ptr&& file, verify policy) {
 			file_ = std::move(file);
+			policy_ = policy;
 			rewind();
-
-			seek_end();
-			seek(0);
 		}
 
 		inline void putback(std::span<std::byte> unread) {
-			putback_.insert(putback_.end(), unread.begin(), unread.end());
+			// unread bytes come before anything still waiting in the buffer
+			putback_.insert(putback_.begin(), unread.begin(), unread.end());
 		}
 
 		template <typename POD>
@@ -56,22 +58,33 @@ namespace arch::io {
 		virtual void rewind();
 		void reset_decompressor();
 		void move_by(size_t) noexcept;
+		void reposition(size_t) noexcept;
 		size_t read_lowlevel(std::span<std::byte> buffer);
 		bool read_ll_char(char&);
 		bool read_exactly(std::span<std::byte> buffer);
+		// compressed input for a single decompress() call
+		std::span<std::byte> input_buffer();
 
 		bool eof() const noexcept { return eof_; }
 		void eof_reached() noexcept;
+		verify policy() const noexcept { return policy_; }
+		void mark_damaged() noexcept { damaged_ = true; }
+		void mark_checked() noexcept { checked_ = true; }
 		base::decompressor* decompressor() const noexcept {
 			return decompressor_.get();
 		}
+		io::seekable* raw_file() const noexcept { return file_.get(); }
 
 	private:
 		seekable::ptr file_{};
 		bool eof_{false};
+		bool damaged_{false};
+		bool checked_{false};
+		verify policy_{verify::immediate};
 		size_t pos_{};
 		size_t size_{};
 		base::decompressor::ptr decompressor_{};
 		std::vector<std::byte> putback_{};
+		std::vector<std::byte> input_{};
 	};
 }  // namespace arch::io
@@ -0,0 +1,80 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <arch/base/compressor.hh>
+#include <arch/base/io/writeable.hh>
+#include <chrono>
+#include <vector>
+
+namespace arch::io {
+	// Compresses everything written to it into another writeable. The
+	// stream is finished by finish(), close() or the destructor, whichever
+	// comes first.
+	class encoding_file final : public writeable {
+		class wrapper_tag {};
+
+	public:
+		static constexpr size_t default_buffer_size = 1024 * 1024;
+
+		static std::unique_ptr<encoding_file> wrap(
+		    writeable::ptr&& file,
+		    base::compressor::ptr&& compressor,
+		    size_t buffer_size = default_buffer_size);
+
+		encoding_file(wrapper_tag,
+		              writeable::ptr&& file,
+		              base::compressor::ptr&& compressor,
+		              size_t buffer_size);
+		~encoding_file();
+
+		void close() final;
+		io::status const& file_status() const final;
+		io::status const& linked_status() const final;
+		fs::path const& linkname() const final;
+		std::size_t write(std::span<std::byte const>) final;
+		std::size_t seek(std::size_t pos) final;
+		std::size_t seek_end() final;
+		std::size_t tell() const final;
+
+		// Emits everything written so far, so that the output can be decoded
+		// up to this point.
+		bool flush();
+		// Ends the compressed stream; nothing can be written afterwards.
+		bool finish();
+		bool failed() const noexcept { return failed_; }
+		size_t bytes_written() const noexcept { return bytes_out_; }
+
+		// Lets the level follow the throughput: after each buffer, the time
+		// spent in the encoder is compared with the time spent writing the
+		// output. A slower output raises the level, a slower encoder lowers
+		// it, within the bounds. False, if the compressor is not able to
+		// change the level mid-stream.
+		bool adapt(int min_level, int max_level, int start_level);
+		int level() const noexcept { return level_; }
+
+	private:
+		using clock = std::chrono::steady_clock;
+
+		std::pair<size_t, size_t> encode(std::span<std::byte const> data,
+		                                 base::flush_mode mode);
+		bool flush_impl(base::flush_mode mode);
+		bool drain();
+		void adjust_level(clock::duration sink_time);
+
+		writeable::ptr file_{};
+		base::compressor::ptr compressor_{};
+		std::vector<std::byte> buffer_{};
+		size_t fill_{};
+		size_t pos_{};
+		size_t bytes_out_{};
+		bool failed_{false};
+
+		bool adaptive_{false};
+		int min_level_{};
+		int max_level_{};
+		int level_{-1};
+		clock::duration encoder_time_{};
+	};
+}  // namespace arch::io
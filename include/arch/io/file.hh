@@ -38,6 +38,8 @@ namespace arch::io {
 		std::size_t seek_end() final;
 		std::size_t tell() const final;
 
+		std::FILE* handle() const noexcept { return file_.get(); }
+
 	private:
 		static fptr fopen(std::string const& utf8path, const char* mode);
 #ifdef WIN32
@@ -4,16 +4,29 @@
 #pragma once
 
 #include <arch/io/decoding_file.hh>
+#include <arch/zlib.hh>
 
 namespace arch::io {
 	class gzip final : public decoding_file {
 		class wrapper_tag {};
 
 	public:
-		explicit gzip(wrapper_tag);
+		gzip(wrapper_tag, verify policy);
 		static bool is_valid(io::seekable* file);
-		static io::seekable::ptr wrap(io::seekable::ptr&& file);
+		static bool is_valid(std::span<std::byte const> prefix);
+		static io::seekable::ptr wrap(io::seekable::ptr&& file,
+		                              open_options const& opts);
 		std::size_t read(std::span<std::byte>) final;
+		verify_result verification() final;
+
+		// Decodes a single-member gzip held in memory, sizing the output
+		// from the ISIZE field. Returns false for anything else (including
+		// multi-member files, data above 4GiB and an ISIZE no deflate
+		// stream of this size could reach), leaving the streaming
+		// interface as the fallback.
+		static bool decode_all(std::span<std::byte const> input,
+		                       std::vector<std::byte>& output,
+		                       verify policy = base::default_verify());
 
 	private:
 		base::decompressor::ptr make_decompressor() final;
@@ -24,7 +37,6 @@ namespace arch::io {
 		void skip_asciiz();
 
 		bool new_member_{true};
-		size_t stream_size_{};
-		unsigned long crc32_{};
+		zlib::crc32_check check_;
 	};
 }  // namespace arch::io
@@ -0,0 +1,47 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <arch/io/decoding_file.hh>
+#include <arch/lz4.hh>
+#include <optional>
+
+namespace arch::io {
+	class lz4 final : public decoding_file {
+		class wrapper_tag {};
+
+	public:
+		lz4(wrapper_tag);
+		static bool is_valid(io::seekable* file);
+		static bool is_valid(std::span<std::byte const> prefix);
+		static io::seekable::ptr wrap(io::seekable::ptr&& file,
+		                              open_options const& opts);
+		std::size_t read(std::span<std::byte>) final;
+
+		// Sum of the sizes declared in frame headers, available without
+		// decoding anything, if every frame in the file declares one.
+		// Collected on the first call, from headers and block sizes only.
+		std::optional<uint64_t> content_size() const;
+		static std::optional<uint64_t> content_size(io::seekable* file);
+
+	private:
+		enum class mode { frame, blocks, stream, done };
+
+		base::decompressor::ptr make_decompressor() final;
+		void rewind() final;
+		bool next_frame();
+		bool next_blocks();
+		bool skip_lowlevel(size_t length);
+
+		mutable std::optional<uint64_t> content_size_{};
+		mutable bool content_size_known_{false};
+		mode mode_{mode::frame};
+		arch::lz4::frame_header frame_{};
+		arch::lz4::xxh32 content_hash_{};
+		std::vector<std::byte> packed_{};
+		std::vector<std::byte> batch_{};
+		size_t batch_pos_{};
+		size_t batch_size_{};
+	};
+}  // namespace arch::io
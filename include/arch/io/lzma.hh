@@ -12,7 +12,9 @@ namespace arch::io {
 	public:
 		explicit lzma(wrapper_tag);
 		static bool is_valid(io::seekable* file);
-		static io::seekable::ptr wrap(io::seekable::ptr&& file);
+		static bool is_valid(std::span<std::byte const> prefix);
+		static io::seekable::ptr wrap(io::seekable::ptr&& file,
+		                              open_options const& opts);
 
 	private:
 		base::decompressor::ptr make_decompressor() final;
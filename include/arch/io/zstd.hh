@@ -0,0 +1,51 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <arch/io/decoding_file.hh>
+
+namespace arch::io {
+	class zstd final : public decoding_file {
+		class wrapper_tag {};
+
+	public:
+		// Position of one frame listed in the seekable format's seek table.
+		struct frame {
+			size_t offset{};
+			size_t decoded_offset{};
+			size_t size{};
+			size_t decoded_size{};
+		};
+
+		zstd(wrapper_tag, std::vector<frame>&& frames);
+		static bool is_valid(io::seekable* file);
+		static bool is_valid(std::span<std::byte const> prefix);
+		static io::seekable::ptr wrap(io::seekable::ptr&& file,
+		                              open_options const& opts);
+		std::size_t read(std::span<std::byte>) final;
+		std::size_t seek(std::size_t pos) final;
+		std::size_t seek_end() final;
+
+		// True, if the file ends with a seek table; seek() then jumps
+		// straight to the frame holding the position, and sequential reads
+		// decode several frames at the same time.
+		bool has_seek_table() const noexcept { return !frames_.empty(); }
+		static std::vector<frame> read_seek_table(io::seekable* file);
+
+	private:
+		base::decompressor::ptr make_decompressor() final;
+		void rewind() final;
+		bool next_batch();
+
+		std::vector<frame> frames_{};
+		size_t decoded_size_{};
+		size_t next_frame_{};
+		size_t skip_{};
+		std::vector<std::byte> packed_{};
+		std::vector<std::byte> batch_{};
+		size_t batch_pos_{};
+		size_t batch_size_{};
+		size_t batch_start_{};
+	};
+}  // namespace arch::io
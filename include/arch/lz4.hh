@@ -0,0 +1,86 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <lz4frame.h>
+#include <arch/base/decompressor.hh>
+#include <arch/base/verify.hh>
+#include <cstdint>
+#include <optional>
+
+namespace arch::lz4 {
+	inline constexpr uint32_t frame_magic = 0x184D2204;
+	inline constexpr size_t max_frame_header = 19;
+
+	inline constexpr bool is_skippable(uint32_t magic) noexcept {
+		return (magic & 0xFFFFFFF0) == 0x184D2A50;
+	}
+
+	struct frame_header {
+		size_t size{};
+		size_t block_max{};
+		std::optional<uint64_t> content_size{};
+		bool independent_blocks{};
+		bool block_checksum{};
+		bool content_checksum{};
+		bool dictionary{};
+	};
+
+	// Parses the magic and the frame descriptor at the start of the data,
+	// including the descriptor's checksum. Returns nullopt for anything but
+	// a complete and supported frame header.
+	std::optional<frame_header> read_frame_header(
+	    std::span<std::byte const> data) noexcept;
+
+	// XXH32, as used by the frame format for its header, block and content
+	// checksums.
+	class xxh32 {
+	public:
+		explicit xxh32(uint32_t seed = 0) noexcept { reset(seed); }
+		void reset(uint32_t seed = 0) noexcept;
+		void update(std::span<std::byte const> data) noexcept;
+		uint32_t digest() const noexcept;
+
+		static uint32_t hash(std::span<std::byte const> data,
+		                     uint32_t seed = 0) noexcept {
+			xxh32 state{seed};
+			state.update(data);
+			return state.digest();
+		}
+
+	private:
+		uint32_t acc_[4]{};
+		uint32_t seed_{};
+		uint64_t total_{};
+		std::byte tail_[16]{};
+		size_t tail_size_{};
+	};
+
+	struct stream {
+		LZ4F_dctx* ctx{};
+		bool skip_checksums{};
+		char const* next_in{};
+		size_t avail_in{};
+		char* next_out{};
+		size_t avail_out{};
+		// last result of LZ4F_decompress, 0 once a frame is flushed
+		size_t pending{};
+	};
+
+	class decompressor final : public base::decompressor {
+	public:
+		explicit decompressor(base::verify policy = base::verify::immediate);
+		~decompressor();
+		bool eof() const noexcept final { return eof_; }
+		bool damaged() const noexcept final { return damaged_; }
+		std::pair<size_t, size_t> decompress(std::span<std::byte> input,
+		                                     std::span<std::byte> output) final;
+		bool reset() noexcept final;
+
+	private:
+		bool eof_{false};
+		bool damaged_{false};
+		stream lzs_{};
+	};
+}  // namespace arch::lz4
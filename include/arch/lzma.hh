@@ -8,19 +8,58 @@
 #undef min
 #undef max
 #endif
+#include <arch/base/compressor.hh>
 #include <arch/base/decompressor.hh>
+#include <arch/base/verify.hh>
 
 namespace arch::lzma {
 	class decompressor final : public base::decompressor {
 	public:
-		decompressor();
+		explicit decompressor(base::verify policy = base::verify::immediate);
 		~decompressor();
 		bool eof() const noexcept final { return eof_; }
+		bool damaged() const noexcept final { return damaged_; }
 		std::pair<size_t, size_t> decompress(std::span<std::byte> input,
 		                                     std::span<std::byte> output) final;
 
 	private:
 		bool eof_{false};
+		bool damaged_{false};
+		int is_initialised_{false};
+		lzma_stream lzs_{};
+	};
+
+	// Settings of the multi-threaded encoder. The output is split into
+	// independent blocks, which also lets the readers decode it in
+	// parallel, or start in the middle.
+	struct threading {
+		// 0 for one thread per processor
+		uint32_t threads{0};
+		// 0 lets liblzma choose (three times the dictionary size)
+		uint64_t block_size{0};
+		// the thread count is lowered, until the encoder fits; 0 for no
+		// limit
+		uint64_t memlimit{0};
+	};
+
+	class compressor final : public base::compressor {
+	public:
+		// preset is 0-9, optionally combined with LZMA_PRESET_EXTREME
+		explicit compressor(uint32_t preset = 6,
+		                    lzma_check check = LZMA_CHECK_CRC64);
+		compressor(threading const& mt,
+		           uint32_t preset = 6,
+		           lzma_check check = LZMA_CHECK_CRC64);
+		~compressor();
+		bool finished() const noexcept final { return finished_; }
+		bool failed() const noexcept final { return failed_; }
+		std::pair<size_t, size_t> compress(std::span<std::byte const> input,
+		                                   std::span<std::byte> output,
+		                                   base::flush_mode mode) final;
+
+	private:
+		bool finished_{false};
+		bool failed_{false};
 		int is_initialised_{false};
 		lzma_stream lzs_{};
 	};
@@ -4,6 +4,10 @@
 #pragma once
 
 #include <arch/base/archive.hh>
+#include <functional>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 namespace arch::tar {
@@ -13,11 +17,44 @@ namespace arch::tar {
 		~archive() { close(); }
 
 		static bool is_valid(io::seekable*);
+		static bool is_valid(std::span<std::byte const> prefix);
 
-		bool open(io::seekable::ptr) final;
+		// Gets each member with its contents, as the header is read;
+		// entry.file() reads from the same contents. Neither outlives the
+		// call. Returning false stops the walk.
+		using visitor = std::function<bool(base::entry const& entry,
+		                                   io::stream& contents)>;
+
+		// Walks the archive once, front to back, without seeking: a
+		// compressed source is decoded only once for listing and extraction
+		// together. Links are resolved against the members seen so far.
+		// False, if the source ends inside a member or a header is broken.
+		static bool for_each_entry(io::stream& source,
+		                           visitor const& visit,
+		                           open_options const& opts = {});
+
+		// Headers are read as they are needed: open() reads the first one,
+		// entry() reads up to the one asked for and count() reads all of
+		// them. Links might need to read further, until their target is
+		// found. The lookups are serialised, so one archive can be queried
+		// from several threads; the entries still share the source file.
+		bool open(io::seekable::ptr, open_options const&) final;
 		void close() final;
 		size_t count() const final;
 		base::entry::ptr entry(size_t) const final;
+		// reads the headers only up to the member, or not at all, if the
+		// catalog was used
+		base::entry::ptr find(std::string_view name) const final;
+
+		// members read so far, without reading any further
+		size_t known_count() const {
+			std::lock_guard lock{mutex_};
+			return entries_.count();
+		}
+		bool fully_loaded() const {
+			std::lock_guard lock{mutex_};
+			return at_end_;
+		}
 
 	private:
 		struct Entry {
@@ -28,22 +65,112 @@ namespace arch::tar {
 			int chksum{};
 			char type{};
 			std::string linkname{};
-			std::string magic{};
 
 			size_t offset{};
 			size_t data_offset{};
+
+			// sparse members keep only the data regions; size is what is
+			// stored and realsize is the size of the whole file
+			bool sparse{};
+			// old GNU: more of the map in the records after the header
+			bool sparse_extended{};
+			// pax 1.0: the map is stored in front of the data
+			bool sparse_map_in_data{};
+			size_t realsize{};
+			std::vector<io::extent> sparse_map{};
+
+			size_t file_size() const noexcept {
+				return sparse ? realsize : size;
+			}
+		};
+
+		// Members kept column by column, with all the names and link names
+		// back to back in one arena
+		struct entry_table {
+			std::string arena{};
+			// member N has its name between bounds 2N and 2N+1 and its link
+			// name between 2N+1 and 2N+2
+			std::vector<uint64_t> bounds{0};
+			std::vector<uint64_t> sizes{};
+			std::vector<uint64_t> data_offsets{};
+			std::vector<time_t> mtimes{};
+			std::vector<unsigned> modes{};
+			std::vector<char> types{};
+			// only the sparse members have one
+			std::unordered_map<size_t, std::vector<io::extent>> sparse_maps{};
+
+			size_t count() const noexcept { return types.size(); }
+			std::string_view name(size_t index) const noexcept {
+				return text(2 * index);
+			}
+			std::string_view linkname(size_t index) const noexcept {
+				return text(2 * index + 1);
+			}
+			std::string_view text(size_t slot) const noexcept {
+				return std::string_view{arena}.substr(
+				    bounds[slot], bounds[slot + 1] - bounds[slot]);
+			}
+			void push(Entry const& entry);
+		};
+
+		static constexpr size_t npos = static_cast<size_t>(-1);
+		static constexpr size_t unresolved = npos;
+		static constexpr size_t dangling = npos - 1;
+
+		// the source a catalog was made for
+		struct catalog_key {
+			uint64_t size{};
+			int64_t mtime{};
+			uint32_t fingerprint{};
 		};
 
+		fs::path catalog_path(fs::path const& dir,
+		                      std::span<std::byte const> head);
+		bool load_catalog();
+		void save_catalog() const;
+
+		size_t lookup(std::string_view name) const;
+		void index_names() const;
+		size_t find_loaded(std::string_view name) const;
+		size_t index_of(std::string const& name) const;
+		size_t next_hop(size_t) const;
 		size_t realpath(size_t) const;
-		size_t hardlink_for(size_t) const;
+		size_t link_for(size_t) const;
+		base::entry::ptr make_entry(size_t) const;
 
-		void load_entries();
-		bool next(Entry&);
-		static bool header(Entry&, io::seekable*);
-		bool apply_gnulong(Entry&);
+		bool load_until(size_t count) const;
+		bool next(Entry&) const;
+		static bool header(Entry&, io::seekable*, bool verify_checksum = true);
+		static bool header(Entry&,
+		                   std::span<std::byte const> record,
+		                   bool verify_checksum = true);
+		bool apply_gnulong(Entry&) const;
+		bool apply_pax(Entry&) const;
+		static void apply_pax_records(Entry&, std::string_view records);
+		static bool read_gnu_sparse(Entry&, io::stream& source);
+		static bool read_sparse_map(Entry&, io::stream& source);
+		static bool finish_sparse(Entry&);
 
 		io::seekable::ptr file_{};
-		std::vector<Entry> entries_{};
-		size_t offset_{};
+		// guards everything below, and the position of file_, while the
+		// headers are read
+		mutable std::mutex mutex_{};
+		// everything below grows while the headers are read
+		mutable entry_table entries_{};
+		// hashes of the names; the arena still moves, while it grows. Only
+		// the lookups by name fill it, up to the members read so far.
+		mutable std::unordered_multimap<size_t, size_t> names_{};
+		mutable size_t named_{};
+		// member each entry links to, after all the hops; the entry itself
+		// for anything else, dangling for broken symlinks
+		mutable std::vector<size_t> links_{};
+		mutable size_t offset_{};
+		mutable bool at_end_{false};
+		// where the end-of-archive marker was read, if it was
+		mutable size_t marker_{npos};
+		verify policy_{verify::immediate};
+		// empty, if no catalog is kept
+		fs::path catalog_{};
+		catalog_key key_{};
 	};
 }  // namespace arch::tar
@@ -5,6 +5,7 @@
 
 #include <arch/base/entry.hh>
 #include <arch/base/io/seekable.hh>
+#include <vector>
 
 namespace arch::tar {
 	class entry final : public base::entry_mixin {
@@ -14,7 +15,8 @@ namespace arch::tar {
 		      io::seekable* proxied,
 		      size_t offset,
 		      io::status const& file_status,
-		      io::status const& status);
+		      io::status const& status,
+		      std::vector<io::extent> sparse_map = {});
 
 		fs::path const& filename() const final;
 		io::stream::ptr file() const final;
@@ -23,5 +25,6 @@ namespace arch::tar {
 		fs::path filename_;
 		io::seekable* proxied_;
 		size_t offset_;
+		std::vector<io::extent> sparse_map_;
 	};
 }  // namespace arch::tar
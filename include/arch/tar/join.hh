@@ -0,0 +1,50 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <zlib.h>
+#include <arch/base/io/writeable.hh>
+#include <vector>
+
+namespace arch::tar {
+	// Joins .tar.gz archives into one, without compressing them again. Each
+	// source is inflated only to find its end-of-archive marker; the deflate
+	// blocks before it are copied as they are and only the data between the
+	// last copied block and the marker is deflated anew. The result is a
+	// single gzip member.
+	class gzip_joiner {
+	public:
+		static constexpr int default_level = 6;
+
+		explicit gzip_joiner(io::writeable::ptr output,
+		                     int level = default_level);
+		~gzip_joiner();
+		gzip_joiner(gzip_joiner const&) = delete;
+		gzip_joiner& operator=(gzip_joiner const&) = delete;
+
+		bool append(io::stream& source);
+		// Writes the end-of-archive marker, the gzip trailer and closes the
+		// output.
+		bool finish();
+		bool failed() const noexcept { return failed_; }
+
+	private:
+		bool encode(std::span<std::byte const> dictionary,
+		            std::span<std::byte const> data,
+		            bool last);
+		bool put(std::span<std::byte const> data);
+
+		io::writeable::ptr output_{};
+		int level_;
+		z_stream z_{};
+		bool is_initialised_{false};
+		std::vector<std::byte> buffer_{};
+		// bits of the last copied byte, which belong to the copied blocks
+		int prime_bits_{};
+		int prime_value_{};
+		unsigned long crc_{};
+		size_t size_{};
+		bool failed_{false};
+	};
+}  // namespace arch::tar
@@ -5,6 +5,7 @@
 
 #include <arch/base/io/seekable.hh>
 #include <arch/base/io/stream.hh>
+#include <vector>
 
 namespace arch::tar {
 	class stream final : public io::stream_mixin {
@@ -13,15 +14,25 @@ namespace arch::tar {
 		       size_t offset,
 		       io::status const& file_status,
 		       io::status const& status,
-		       fs::path const& link);
+		       fs::path const& link,
+		       std::vector<io::extent> sparse_map = {});
 		~stream();
 
 		void close() final;
 		std::size_t read(std::span<std::byte> bytes) final;
+		verify_result verification() final;
+		std::span<io::extent const> sparse_map() const final;
+		std::size_t skip(std::size_t length) final;
 
 	private:
+		std::size_t read_sparse(std::span<std::byte> bytes);
+
 		io::seekable* proxied_{};
 		size_t pos_{};
 		size_t offset_{};
+		// data of a sparse member is stored without the holes
+		std::vector<io::extent> sparse_map_{};
+		size_t sparse_index_{};
+		uintmax_t sparse_stored_{};
 	};
 }  // namespace arch::tar
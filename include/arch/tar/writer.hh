@@ -0,0 +1,73 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <arch/base/fs.hh>
+#include <arch/base/io/writeable.hh>
+#include <ctime>
+#include <string>
+#include <vector>
+
+namespace arch::tar {
+	struct member {
+		std::string name{};
+		fs::file_type type{fs::file_type::regular};
+		fs::perms permissions{fs::perms::owner_read | fs::perms::owner_write |
+		                      fs::perms::group_read | fs::perms::others_read};
+		size_t size{};
+		time_t mtime{};
+		std::string linkname{};
+		// hard link to the linkname member; the type is ignored
+		bool hardlink{false};
+	};
+
+	// Produces ustar archives, falling back to pax records for the names,
+	// links and sizes ustar cannot hold. The output is written in chunks,
+	// which are multiples of the tar record.
+	class writer {
+	public:
+		static constexpr size_t default_chunk_size = 1024 * 1024;
+
+		explicit writer(io::writeable::ptr output,
+		                size_t chunk_size = default_chunk_size);
+		~writer();
+		writer(writer const&) = delete;
+		writer& operator=(writer const&) = delete;
+
+		// Streaming interface: begin() with the header, write() exactly
+		// header.size bytes, end()
+		bool begin(member const& header);
+		bool write(std::span<std::byte const> data);
+		bool end();
+
+		bool add(member const& header, std::span<std::byte const> data);
+		bool add(member const& header, io::stream& source);
+		// Regular files, directories and symlinks from the filesystem; the
+		// contents of regular files are copied by the kernel, when the
+		// output is a plain io::file.
+		bool add_file(fs::path const& path, std::string const& name);
+		// Everything below root, in name order, so the result does not
+		// depend on the order of the directory listing.
+		bool add_tree(fs::path const& root, std::string const& prefix = {});
+
+		// Writes the end-of-archive marker and closes the output.
+		bool finish();
+		bool failed() const noexcept { return failed_; }
+
+	private:
+		bool put(std::span<std::byte const> data);
+		bool put_header(member const& header);
+		bool pad();
+		bool drain();
+		bool copy_file(fs::path const& path, size_t size);
+
+		io::writeable::ptr output_{};
+		std::vector<std::byte> chunk_{};
+		size_t fill_{};
+		size_t remaining_{};
+		size_t written_{};
+		bool in_member_{false};
+		bool failed_{false};
+	};
+}  // namespace arch::tar
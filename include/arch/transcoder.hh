@@ -0,0 +1,41 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <arch/archive.hh>
+#include <arch/tar/writer.hh>
+#include <arch/zip/writer.hh>
+
+namespace arch {
+	// Copies the members of any archive into a writer, without going
+	// through the filesystem. The source is decoded on a separate thread,
+	// while the calling thread encodes the output; the contents are passed
+	// between them in a bounded queue of chunks.
+	class transcoder {
+	public:
+		static constexpr size_t chunk_size = 1024 * 1024;
+		static constexpr size_t queue_depth = 8;
+
+		explicit transcoder(tar::writer& output) : tar_{&output} {}
+		explicit transcoder(zip::writer& output) : zip_{&output} {}
+		virtual ~transcoder();
+
+		bool transcode(fs::path const& path) const;
+		bool transcode(base::archive& archive) const;
+
+		// empty path skips the member
+		virtual fs::path modify_path(fs::path const& filename) const;
+		virtual void on_error(fs::path const& filename, char const* msg) const;
+		virtual void on_note(char const* msg) const;
+
+	private:
+		bool write(fs::path const& name,
+		           io::status const& status,
+		           fs::path const& linkname,
+		           io::stream& contents) const;
+
+		tar::writer* tar_{};
+		zip::writer* zip_{};
+	};
+}  // namespace arch
@@ -15,17 +15,28 @@ namespace arch::zip {
 		~archive() { close(); }
 
 		static bool is_valid(io::seekable*);
+		static bool is_valid(std::span<std::byte const> prefix);
+		// Opens the file, if it is a zip, or leaves it with the caller. For
+		// files without a local header at the start, this is is_valid() and
+		// open() with the directory read only once.
+		static std::unique_ptr<archive> try_open(io::seekable::ptr& file,
+		                                         open_options const& opts);
 
-		bool open(io::seekable::ptr) final;
+		bool open(io::seekable::ptr, open_options const&) final;
 		void close() final;
 		size_t count() const final;
 		base::entry::ptr entry(size_t) const final;
+		base::entry::ptr find(std::string_view name) const final;
 
 	private:
-		static bool open(io::seekable*, void** handle, zip_source_t** source);
+		static bool open(io::seekable*,
+		                 void** handle,
+		                 zip_source_t** source,
+		                 bool check_consistency = true);
 		io::seekable::ptr file_{};
 		void* handle_{nullptr};
 		zip_source_t* source_{nullptr};
+		verify policy_{verify::immediate};
 		std::vector<char> buffer_;
 	};
 }  // namespace arch::zip
@@ -11,14 +11,38 @@ typedef struct zip_stat zip_stat_t;
 namespace arch::zip {
 	class entry final : public base::dos_entry_mixin {
 	public:
-		entry(zip_t* handle, size_t index, zip_stat_t const& st);
+		entry(zip_t* handle,
+		      size_t index,
+		      zip_stat_t const& st,
+		      verify policy);
 
 		fs::path const& filename() const final;
 		io::stream::ptr file() const final;
+		bool read_into(std::span<std::byte> output) const final;
+
+		// Stored and deflated entries can be copied to another archive,
+		// without decoding them.
+		bool is_raw() const noexcept { return raw_; }
+		bool is_deflated() const noexcept;
+		uint32_t crc() const noexcept { return crc_; }
+		uint64_t compressed_size() const noexcept { return compressed_; }
+		// the data, as it is kept in the archive
+		io::stream::ptr compressed_file() const;
+		// the system the member was made on and its external attributes,
+		// from the central directory
+		bool external_attributes(uint8_t& system,
+		                         uint32_t& attributes) const noexcept;
 
 	private:
 		zip_t* handle_;
 		size_t index_;
 		fs::path filename_;
+		verify policy_;
+		// stored and deflated entries are decoded here, so their CRC can be
+		// checked according to the policy
+		bool raw_{false};
+		uint16_t method_{};
+		uint32_t crc_{};
+		uint64_t compressed_{};
 	};
 }  // namespace arch::zip
@@ -5,6 +5,8 @@
 
 #include <zip.h>
 #include <arch/base/io/stream.hh>
+#include <arch/zlib.hh>
+#include <vector>
 
 namespace arch::zip {
 	class stream final : public io::dos_stream_mixin {
@@ -15,15 +17,40 @@ namespace arch::zip {
 
 		using zip_file = std::unique_ptr<zip_file_t, file_closer>;
 
+		struct raw_entry {
+			uint16_t method{};
+			uint32_t crc{};
+		};
+
 		stream(zip_file&& handle, io::status const& status);
+		stream(zip_file&& handle,
+		       io::status const& status,
+		       raw_entry const& raw,
+		       verify policy);
 		~stream();
 
 		void close() final;
 		std::size_t read(std::span<std::byte> bytes) final;
+		verify_result verification() final;
 
 	private:
+		std::size_t read_libzip(std::span<std::byte> bytes);
+		std::size_t read_raw(std::span<std::byte> bytes);
+		std::size_t inflate(std::span<std::byte> bytes);
+
 		zip_file handle_;
 		size_t size_;
 		time_t mtime_;
+
+		bool raw_{false};
+		bool damaged_{false};
+		bool libzip_checked_{false};
+		uint32_t crc_{};
+		size_t pos_{};
+		base::decompressor::ptr decompressor_{};
+		zlib::crc32_check check_;
+		std::vector<std::byte> input_{};
+		size_t input_pos_{};
+		size_t input_end_{};
 	};
 }  // namespace arch::zip
@@ -0,0 +1,115 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <arch/base/fs.hh>
+#include <arch/base/io/writeable.hh>
+#include <ctime>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace arch::zip {
+	// How the central directory of another archive describes a member: the
+	// system it was made on and its external attributes
+	struct attributes {
+		unsigned system{};
+		unsigned long external{};
+	};
+
+	struct member {
+		std::string name{};
+		fs::file_type type{fs::file_type::regular};
+		fs::perms permissions{fs::perms::owner_read | fs::perms::owner_write |
+		                      fs::perms::group_read | fs::perms::others_read};
+		time_t mtime{};
+		// written as they are, instead of the ones made from the type and
+		// the permissions
+		std::optional<attributes> copied{};
+	};
+
+	// Member compressed elsewhere, stored or as a raw deflate stream
+	struct raw_member {
+		member header{};
+		bool deflated{false};
+		unsigned long crc{};
+		size_t size{};
+		size_t compressed_size{};
+	};
+
+	class archive;
+
+	// Produces zip archives (with zip64 records, when needed). The members
+	// are collected in batches and deflated on the library's worker pool,
+	// one task per member; each is written as soon as it and the ones added
+	// before it are done, so the output does not depend on the number of
+	// threads. Members larger than the batch are deflated in blocks on the
+	// same pool, while they are read.
+	class writer {
+	public:
+		static constexpr int default_level = 6;
+		static constexpr size_t default_batch_size = 64 * 1024 * 1024;
+
+		explicit writer(io::writeable::ptr output,
+		                int level = default_level,
+		                size_t batch_size = default_batch_size);
+		~writer();
+		writer(writer const&) = delete;
+		writer& operator=(writer const&) = delete;
+
+		bool add(member const& header, std::vector<std::byte>&& data);
+		bool add(member const& header, std::span<std::byte const> data);
+		bool add(member const& header, io::stream& source, size_t size);
+		// Copies compressed_size bytes of the source as they are
+		bool add_raw(raw_member const& info, io::stream& compressed);
+		// Copies all the members of the source; stored and deflated ones
+		// are not decoded, only the rest is compressed again.
+		bool merge(zip::archive const& source);
+		// Regular files, directories and symlinks from the filesystem
+		bool add_file(fs::path const& path, std::string const& name);
+		// The same members, in the same order, tar::writer::add_tree()
+		// would write
+		bool add_tree(fs::path const& root, std::string const& prefix = {});
+
+		// Writes the pending members, the central directory and closes the
+		// output.
+		bool finish();
+		bool failed() const noexcept { return failed_; }
+
+	private:
+		struct job {
+			member header{};
+			std::vector<std::byte> data{};
+			std::vector<std::byte> packed{};
+			unsigned long crc{};
+			bool deflated{false};
+		};
+
+		struct record {
+			member const* header;
+			unsigned long crc;
+			bool deflated;
+			bool streamed;
+			bool zip64;
+			size_t compressed;
+			size_t size;
+		};
+
+		bool flush_batch();
+		bool stream(member const& header, io::stream& source, size_t size);
+		bool put_local(record const& entry);
+		void put_central(record const& entry, size_t local_offset);
+		bool put(std::span<std::byte const> data);
+
+		io::writeable::ptr output_{};
+		int level_;
+		size_t batch_size_;
+		std::vector<job> batch_{};
+		size_t batch_fill_{};
+		std::vector<std::byte> central_{};
+		size_t entries_{};
+		size_t offset_{};
+		bool failed_{false};
+	};
+}  // namespace arch::zip
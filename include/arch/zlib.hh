@@ -4,7 +4,10 @@
 #pragma once
 
 #include <zlib.h>
+#include <arch/base/compressor.hh>
 #include <arch/base/decompressor.hh>
+#include <arch/base/verify.hh>
+#include <vector>
 
 namespace arch::zlib {
 	class decompressor final : public base::decompressor {
@@ -12,12 +15,109 @@ namespace arch::zlib {
 		explicit decompressor(int wbits);
 		~decompressor();
 		bool eof() const noexcept final { return eof_; }
+		bool damaged() const noexcept final { return damaged_; }
 		std::pair<size_t, size_t> decompress(std::span<std::byte> input,
 		                                     std::span<std::byte> output) final;
+		bool reset() noexcept final;
 
 	private:
 		bool eof_{false};
+		bool damaged_{false};
 		int is_initialised_{false};
 		z_stream z_{};
 	};
+
+	enum class format { raw, zlib, gzip };
+
+	class compressor final : public base::compressor {
+	public:
+		explicit compressor(int level = Z_DEFAULT_COMPRESSION,
+		                    format container = format::gzip);
+		~compressor();
+		bool finished() const noexcept final { return finished_; }
+		bool failed() const noexcept final { return failed_; }
+		std::pair<size_t, size_t> compress(std::span<std::byte const> input,
+		                                   std::span<std::byte> output,
+		                                   base::flush_mode mode) final;
+		bool reset() noexcept final;
+		bool set_level(int level) noexcept final;
+
+	private:
+		bool finished_{false};
+		bool failed_{false};
+		int is_initialised_{false};
+		int level_;
+		int requested_level_;
+		z_stream z_{};
+	};
+
+	// Single-member gzip, deflated in blocks on the library's worker pool.
+	// Each block is primed with the 32KiB of input before it, so the
+	// output is close to what a single stream would give, and is readable
+	// by any gzip tool. With format::raw, only the deflate stream is
+	// produced; format::zlib is not supported.
+	class parallel_compressor final : public base::compressor {
+	public:
+		static constexpr size_t default_block_size = 128 * 1024;
+
+		explicit parallel_compressor(
+		    int level = Z_DEFAULT_COMPRESSION,
+		    size_t block_size = default_block_size,
+		    format container = format::gzip);
+		~parallel_compressor();
+		bool finished() const noexcept final { return finished_; }
+		bool failed() const noexcept final { return failed_; }
+		std::pair<size_t, size_t> compress(std::span<std::byte const> input,
+		                                   std::span<std::byte> output,
+		                                   base::flush_mode mode) final;
+		bool reset() noexcept final;
+		bool set_level(int level) noexcept final;
+		// CRC32 of the input deflated so far
+		unsigned long crc() const noexcept { return crc_; }
+
+	private:
+		void encode_batch(bool last);
+		size_t drain(std::span<std::byte> output);
+
+		int level_;
+		size_t block_size_;
+		size_t batch_size_;
+		format container_;
+		std::vector<std::byte> data_{};
+		size_t window_{};
+		std::vector<std::byte> queue_{};
+		size_t queue_pos_{};
+		unsigned long crc_{};
+		uint64_t size_{};
+		bool finishing_{false};
+		bool finished_{false};
+		bool failed_{false};
+	};
+
+	// zlib's crc32() for spans larger than uInt can describe
+	unsigned long crc32_update(unsigned long crc,
+	                           std::span<std::byte const> data) noexcept;
+
+	// CRC32 of the decoded data (gzip members, zip entries), computed
+	// according to the verification policy.
+	class crc32_check {
+	public:
+		explicit crc32_check(base::verify policy = base::verify::immediate);
+		~crc32_check();
+		crc32_check(crc32_check const&) = delete;
+		crc32_check& operator=(crc32_check const&) = delete;
+
+		base::verify policy() const noexcept { return policy_; }
+		void start();
+		void update(std::span<std::byte const> data);
+		// false, if the reader should stop, because of a mismatch
+		bool finish(uint32_t crc, uint64_t size);
+		base::verify_result result();
+
+	private:
+		struct state;
+
+		base::verify policy_;
+		std::shared_ptr<state> state_;
+	};
 }  // namespace arch::zlib
@@ -0,0 +1,38 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <zstd.h>
+#include <arch/base/decompressor.hh>
+#include <arch/base/verify.hh>
+
+namespace arch::zstd {
+	// zstd buffers expressed as the next_/avail_ pairs impl::decompress()
+	// is written against
+	struct stream {
+		ZSTD_DCtx* ctx{};
+		char const* next_in{};
+		size_t avail_in{};
+		char* next_out{};
+		size_t avail_out{};
+		// last result of ZSTD_decompressStream, 0 once a frame is flushed
+		size_t pending{};
+	};
+
+	class decompressor final : public base::decompressor {
+	public:
+		explicit decompressor(base::verify policy = base::verify::immediate);
+		~decompressor();
+		bool eof() const noexcept final { return eof_; }
+		bool damaged() const noexcept final { return damaged_; }
+		std::pair<size_t, size_t> decompress(std::span<std::byte> input,
+		                                     std::span<std::byte> output) final;
+		bool reset() noexcept final;
+
+	private:
+		bool eof_{false};
+		bool damaged_{false};
+		stream zs_{};
+	};
+}  // namespace arch::zstd
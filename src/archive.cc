@@ -5,104 +5,337 @@
 
 #include <arch/io/bzip2.hh>
 #include <arch/io/gzip.hh>
+#include <arch/io/lz4.hh>
 #include <arch/io/lzma.hh>
+#include <arch/io/zstd.hh>
 #include <arch/tar/archive.hh>
 #include <arch/zip/archive.hh>
 
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+
 namespace arch {
 	namespace {
-		struct filter_info {
-			bool (*is_valid)(io::seekable* file);
-			io::seekable::ptr (*wrap)(io::seekable::ptr&& file);
-
-			template <typename Filter>
-			struct from {
-				static bool is_valid(io::seekable* file) {
-					return Filter::is_valid(file);
-				}
+		// enough for every signature, including the ustar magic of the
+		// first tar header
+		constexpr size_t prefix_size = 512;
+
+		// Gives the next layer the prefix read for detection once again,
+		// before reading on from the file below. Going back to the start of
+		// a decoding_file would otherwise mean decoding the prefix anew.
+		class sniffed_file final : public io::seekable {
+		public:
+			sniffed_file(io::seekable::ptr&& file,
+			             std::vector<std::byte> const& prefix)
+			    : file_{std::move(file)}, prefix_{prefix} {}
 
-				static io::seekable::ptr wrap(io::seekable::ptr&& file) {
-					return Filter::wrap(std::move(file));
+			void close() final { file_->close(); }
+			io::status const& file_status() const final {
+				return file_->file_status();
+			}
+			io::status const& linked_status() const final {
+				return file_->linked_status();
+			}
+			fs::path const& linkname() const final {
+				return file_->linkname();
+			}
+			verify_result verification() final {
+				return file_->verification();
+			}
+
+			std::size_t read(std::span<std::byte> buffer) final {
+				size_t result{};
+				if (pos_ < prefix_.size()) {
+					result = std::min(buffer.size(), prefix_.size() - pos_);
+					std::memcpy(buffer.data(), prefix_.data() + pos_, result);
+					pos_ += result;
+					buffer = buffer.subspan(result);
+					if (buffer.empty()) return result;
 				}
 
-				constexpr operator filter_info() const {
-					return {is_valid, wrap};
+				// the detection might have moved the file below
+				if (file_->tell() != pos_ && file_->seek(pos_) != pos_)
+					return result;
+
+				auto const read = file_->read(buffer);
+				pos_ += read;
+				return result + read;
+			}
+
+			std::size_t seek(std::size_t pos) final {
+				pos_ = pos <= prefix_.size() ? pos : file_->seek(pos);
+				return pos_;
+			}
+
+			std::size_t seek_end() final {
+				pos_ = file_->seek_end();
+				return pos_;
+			}
+
+			std::size_t tell() const final { return pos_; }
+
+		private:
+			io::seekable::ptr file_;
+			std::vector<std::byte> prefix_;
+			size_t pos_{};
+		};
+
+		std::vector<std::byte> read_prefix(io::seekable* file) {
+			std::vector<std::byte> prefix(prefix_size);
+			size_t size{};
+			if (file->seek(0) == 0) {
+				while (size < prefix.size()) {
+					auto const read =
+					    file->read(std::span{prefix}.subspan(size));
+					if (!read) break;
+					size += read;
 				}
-			};
+			}
+			prefix.resize(size);
+			return prefix;
+		}
+
+		template <typename Archive>
+		base::archive::ptr open_archive(io::seekable::ptr&& file,
+		                                open_options const& opts) {
+			auto ptr = std::make_unique<Archive>();
+			if (!ptr->open(std::move(file), opts)) ptr.reset();
+			return ptr;
+		}
+
+		base::archive::ptr probe_zip(io::seekable::ptr& file,
+		                             open_options const& opts) {
+			return zip::archive::try_open(file, opts);
+		}
+
+		struct registry {
+			registry() {
+				filters = {
+				    {"gzip", {{"gz"}, {"tgz", "tar"}}, io::gzip::is_valid,
+				     io::gzip::wrap},
+				    {"bzip2",
+				     {{"bz2"},
+				      {"tbz", "tar"},
+				      {"tbz2", "tar"},
+				      {"tb2", "tar"},
+				      {"tz2", "tar"}},
+				     io::bzip2::is_valid,
+				     io::bzip2::wrap},
+				    {"xz", {{"xz"}, {"txz", "tar"}}, io::lzma::is_valid,
+				     io::lzma::wrap},
+				    {"zstd", {{"zst"}, {"tzst", "tar"}}, io::zstd::is_valid,
+				     io::zstd::wrap},
+				    {"lz4", {{"lz4"}}, io::lz4::is_valid, io::lz4::wrap},
+				};
+
+				// zips not starting with a local header, or without any
+				// entries, are only found by reading their central directory
+				archives = {
+				    {"zip", {"zip"}, zip::archive::is_valid,
+				     open_archive<zip::archive>, probe_zip},
+				    {"tar", {"tar"}, tar::archive::is_valid,
+				     open_archive<tar::archive>, nullptr, true},
+				};
+			}
+
+			std::shared_mutex m{};
+			// deques keep the references, handed out by known_extentions()
+			std::deque<filter_info> filters{};
+			std::deque<archive_info> archives{};
+			std::deque<std::string> known{};
 		};
 
-		struct archive_info {
-			bool (*is_valid)(io::seekable* file);
-			base::archive::ptr (*open)(io::seekable::ptr&& file);
+		registry& formats() {
+			static registry all{};
+			return all;
+		}
+
+		// the name is lowercased, the registered suffixes are expected to
+		// be lowercase already
+		bool claims(std::string_view name, std::string_view suffix) {
+			return !suffix.empty() && name.size() > suffix.size() &&
+			       name.ends_with(suffix) &&
+			       name[name.size() - suffix.size() - 1] == '.';
+		}
+
+		filter_info::extension const* claimed_by(filter_info const& nfo,
+		                                         std::string_view name) {
+			for (auto const& ext : nfo.extensions) {
+				if (claims(name, ext.suffix)) return &ext;
+			}
+			return nullptr;
+		}
 
-			template <typename Archive>
-			struct from {
-				static bool is_valid(io::seekable* file) {
-					return Archive::is_valid(file);
+		bool claimed_by(archive_info const& nfo, std::string_view name) {
+			return std::any_of(
+			    nfo.extensions.begin(), nfo.extensions.end(),
+			    [name](auto const& suffix) { return claims(name, suffix); });
+		}
+
+		struct hint_state {
+			std::string name{};
+			bool exclusive{false};
+		};
+
+		// Each layer is read only once for the detection: the same prefix is
+		// matched against every signature and replayed to the filter which
+		// recognized it. Filters claiming the extension of the hint go first.
+		open_status wrap(io::seekable::ptr& file,
+		                 std::vector<std::byte>& prefix,
+		                 hint_state& hint,
+		                 registry const& all,
+		                 open_options const& opts) {
+			while (true) {
+				prefix = read_prefix(file.get());
+				file = std::make_unique<sniffed_file>(std::move(file), prefix);
+
+				filter_info const* found{};
+				filter_info::extension const* claimed{};
+				for (auto const& nfo : all.filters) {
+					auto const ext = claimed_by(nfo, hint.name);
+					if (!ext || !nfo.is_valid(prefix)) continue;
+					found = &nfo;
+					claimed = ext;
+					break;
 				}
 
-				static base::archive::ptr open(io::seekable::ptr&& file) {
-					auto ptr = std::make_unique<Archive>();
-					if (!ptr->open(std::move(file))) ptr.reset();
-					return ptr;
+				if (!found && !hint.exclusive) {
+					for (auto const& nfo : all.filters) {
+						if (claimed_by(nfo, hint.name) || !nfo.is_valid(prefix))
+							continue;
+						found = &nfo;
+						break;
+					}
 				}
 
-				constexpr operator archive_info() const {
-					return {is_valid, open};
+				if (!found) return open_status::ok;
+
+				if (claimed) {
+					hint.name.resize(hint.name.size() - claimed->suffix.size() -
+					                 1);
+					if (!claimed->inner.empty())
+						hint.name.append(1, '.').append(claimed->inner);
 				}
-			};
-		};
 
-		open_status wrap(io::seekable::ptr& file) {
-			static constexpr filter_info all_filters[] = {
-			    filter_info::from<io::gzip>{},
-			    filter_info::from<io::bzip2>{},
-			    filter_info::from<io::lzma>{},
-			};
-
-			bool modified = true;
-			while (modified) {
-				modified = false;
-				for (auto const& nfo : all_filters) {
-					file->seek(0);
-					if (!nfo.is_valid(file.get())) continue;
+				file = found->wrap(std::move(file), opts);
+				if (!file) return open_status::compression_damaged;
+			}
+		}
+
+		open_status open_impl(io::seekable::ptr file,
+		                      base::archive::ptr& archive,
+		                      hint_state& hint,
+		                      open_options const& opts) {
+			if (!file) return open_status::archive_unknown;
+
+			auto& all = formats();
+			std::shared_lock lock{all.m};
+
+			std::vector<std::byte> prefix{};
+			auto result = wrap(file, prefix, hint, all, opts);
+			if (result != open_status::ok) return result;
+
+			// the hinted archives first, the rest afterwards; each time
+			// with the prefix and only then the probes
+			for (auto const hinted : {true, false}) {
+				if (!hinted && hint.exclusive) break;
+
+				for (auto const& nfo : all.archives) {
+					if (claimed_by(nfo, hint.name) != hinted ||
+					    !nfo.is_valid(prefix))
+						continue;
 
 					file->seek(0);
-					file = nfo.wrap(std::move(file));
-					if (!file) return open_status::compression_damaged;
-					modified = true;
-					break;
+					archive = nfo.open(std::move(file), opts);
+					return archive ? open_status::ok
+					               : open_status::archive_damaged;
+				}
+
+				for (auto const& nfo : all.archives) {
+					if (!nfo.probe || claimed_by(nfo, hint.name) != hinted)
+						continue;
+
+					archive = nfo.probe(file, opts);
+					if (archive) return open_status::ok;
 				}
 			}
 
-			return open_status::ok;
+			return open_status::archive_unknown;
 		}
 	}  // namespace
 
-	open_status open(io::seekable::ptr file, base::archive::ptr& archive) {
-		auto result = wrap(file);
-		if (result != open_status::ok) return result;
+	void register_filter(filter_info const& info) {
+		auto& all = formats();
+		std::unique_lock lock{all.m};
+		all.filters.push_back(info);
+	}
 
-		static constexpr archive_info all_archives[] = {
-		    archive_info::from<zip::archive>{},
-		    archive_info::from<tar::archive>{},
-		};
+	void register_archive(archive_info const& info) {
+		auto& all = formats();
+		std::unique_lock lock{all.m};
+		all.archives.push_back(info);
+	}
 
-		for (auto const& nfo : all_archives) {
-			file->seek(0);
-			if (!nfo.is_valid(file.get())) continue;
-			file->seek(0);
-			archive = nfo.open(std::move(file));
-			return archive ? open_status::ok : open_status::archive_damaged;
-		}
+	open_status open(io::seekable::ptr file,
+	                 base::archive::ptr& archive,
+	                 open_options const& opts) {
+		hint_state hint{};
+		return open_impl(std::move(file), archive, hint, opts);
+	}
 
-		return open_status::archive_unknown;
+	open_status open(io::seekable::ptr file,
+	                 base::archive::ptr& archive,
+	                 format_hint const& hint,
+	                 open_options const& opts) {
+		hint_state state{.name = hint.filename.filename().string()};
+		std::transform(state.name.begin(), state.name.end(),
+		               state.name.begin(), [](char c) {
+			               return static_cast<char>(
+			                   std::tolower(static_cast<unsigned char>(c)));
+		               });
+		state.exclusive = hint.exclusive && !state.name.empty();
+		return open_impl(std::move(file), archive, state, opts);
 	}
 
 	std::vector<std::string_view> known_extentions() {
-		return {
-		    "zip",     "tar.gz", "tgz", "tar.xz", "txz",
-		    "tar.bz2", "tb2",    "tbz", "tbz2",   "tz2",
-		};
+		auto& all = formats();
+		std::unique_lock lock{all.m};
+
+		// every archive, the filterable ones also in every filter, and the
+		// short forms
+		std::vector<std::string> names{};
+		std::vector<std::string> filterable{};
+		for (auto const& nfo : all.archives) {
+			names.insert(names.end(), nfo.extensions.begin(),
+			             nfo.extensions.end());
+			if (nfo.filterable)
+				filterable.insert(filterable.end(), nfo.extensions.begin(),
+				                  nfo.extensions.end());
+		}
+		for (auto const& nfo : all.filters) {
+			for (auto const& ext : nfo.extensions) {
+				if (!ext.inner.empty()) {
+					names.push_back(ext.suffix);
+					continue;
+				}
+				for (auto const& archive : filterable)
+					names.push_back(archive + "." + ext.suffix);
+			}
+		}
+
+		std::vector<std::string_view> result{};
+		result.reserve(names.size());
+		for (auto& name : names) {
+			auto it = std::find(all.known.begin(), all.known.end(), name);
+			if (it == all.known.end())
+				it = all.known.insert(all.known.end(), std::move(name));
+			if (std::find(result.begin(), result.end(), *it) == result.end())
+				result.push_back(*it);
+		}
+		return result;
 	}
 }  // namespace arch
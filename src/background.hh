@@ -0,0 +1,29 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+
+namespace arch::impl {
+	// Sequence of tasks executed, in order, on the library's verification
+	// thread. The owner of the lane must keep it alive until the tasks are
+	// done, either by draining it, or by capturing its owner in the tasks.
+	// Posting waits while max_pending tasks are still queued, so a fast
+	// producer cannot pile up its whole output; the tasks must not post.
+	class background_lane {
+	public:
+		static constexpr std::size_t max_pending = 64;
+
+		void post(std::function<void()> task);
+		void drain();
+
+	private:
+		std::mutex m_{};
+		std::condition_variable cv_{};
+		std::size_t pending_{};
+	};
+}  // namespace arch::impl
@@ -5,4 +5,14 @@
 
 namespace arch::base {
 	archive::~archive() = default;
+
+	base::entry::ptr archive::find(std::string_view name) const {
+		auto const entry_count = count();
+		for (size_t index = 0; index < entry_count; ++index) {
+			auto result = entry(index);
+			if (result && result->filename().generic_string() == name)
+				return result;
+		}
+		return {};
+	}
 }
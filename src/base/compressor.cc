@@ -0,0 +1,12 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include <arch/base/compressor.hh>
+
+namespace arch::base {
+	compressor::~compressor() = default;
+
+	bool compressor::reset() noexcept { return false; }
+
+	bool compressor::set_level(int) noexcept { return false; }
+}  // namespace arch::base
@@ -5,4 +5,6 @@
 
 namespace arch::base {
 	decompressor::~decompressor() = default;
-}
+
+	bool decompressor::reset() noexcept { return false; }
+}  // namespace arch::base
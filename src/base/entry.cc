@@ -5,4 +5,24 @@
 
 namespace arch::base {
 	entry::~entry() = default;
-}
+
+	bool entry::read_into(std::span<std::byte> output) const {
+		if (output.size() != file_status().size) return false;
+
+		auto stream = file();
+		if (!stream) return false;
+
+		while (!output.empty()) {
+			auto const read = stream->read(output);
+			if (!read) return false;
+			output = output.subspan(read);
+		}
+
+		return stream->verification() != verify_result::damaged;
+	}
+
+	bool entry::read_all(std::vector<std::byte>& output) const {
+		output.resize(file_status().size);
+		return read_into(output);
+	}
+}  // namespace arch::base
@@ -0,0 +1,70 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include <arch/base/io/stream.hh>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "fs_tree.hh"
+
+namespace arch::impl {
+	bool stat_member(fs::path const& path, fs_member& result) {
+		std::error_code ec{};
+		auto const status = fs::symlink_status(path, ec);
+		if (ec) return false;
+
+		result = {};
+		result.type = status.type();
+		result.permissions = status.permissions() & fs::perms::mask;
+
+		auto const mtime = fs::last_write_time(path, ec);
+		if (!ec) {
+			result.mtime = std::chrono::system_clock::to_time_t(
+			    base::io::to_system_clock(mtime));
+		}
+
+		switch (result.type) {
+			case fs::file_type::regular:
+				result.size = fs::file_size(path, ec);
+				return !ec;
+			case fs::file_type::symlink:
+				result.linkname = fs::read_symlink(path, ec).generic_string();
+				return !ec;
+			case fs::file_type::directory:
+				return true;
+			default:
+				break;
+		}
+
+		return false;
+	}
+
+	bool walk_tree(
+	    fs::path const& root,
+	    std::string const& prefix,
+	    std::function<bool(fs::path const&, std::string const&)> const& add) {
+		std::error_code ec{};
+		std::vector<fs::directory_entry> children{};
+		for (auto const& child : fs::directory_iterator{root, ec})
+			children.push_back(child);
+		if (ec) return false;
+
+		std::sort(children.begin(), children.end(),
+		          [](auto const& lhs, auto const& rhs) {
+			          return lhs.path().filename() < rhs.path().filename();
+		          });
+
+		for (auto const& child : children) {
+			auto const filename = child.path().filename().generic_string();
+			auto const name =
+			    prefix.empty() ? filename : prefix + "/" + filename;
+
+			if (!add(child.path(), name)) return false;
+			if (child.is_directory(ec) && !child.is_symlink(ec) &&
+			    !walk_tree(child.path(), name, add))
+				return false;
+		}
+
+		return true;
+	}
+}  // namespace arch::impl
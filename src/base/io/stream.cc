@@ -3,6 +3,8 @@
 
 #include "arch/base/io/stream.hh"
 
+#include <algorithm>
+
 namespace arch::base::io {
 #if __cpp_lib_chrono >= 201907L
 #define HAS_CXX20_FILE_CLOCK
@@ -71,4 +73,24 @@ namespace arch::base::io {
 	std::size_t stream::read(std::span<std::byte>) {
 		return 0;
 	}
+
+	verify_result stream::verification() {
+		return verify_result::unchecked;
+	}
+
+	std::span<extent const> stream::sparse_map() const {
+		return {};
+	}
+
+	std::size_t stream::skip(std::size_t length) {
+		std::byte buffer[16 * 1024];
+		size_t result{};
+		while (result < length) {
+			auto const chunk = std::min(length - result, sizeof(buffer));
+			auto const read = this->read({buffer, chunk});
+			if (!read) break;
+			result += read;
+		}
+		return result;
+	}
 }  // namespace arch::base::io
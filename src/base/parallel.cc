@@ -0,0 +1,154 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "parallel.hh"
+
+namespace arch::impl {
+	namespace {
+		struct job {
+			std::function<void(std::size_t)> const* task{};
+			std::size_t count{};
+			std::atomic<std::size_t> next{};
+			std::size_t done{};
+			std::size_t workers{};
+			std::condition_variable finished{};
+		};
+
+		class pool {
+		public:
+			pool() {
+				auto const hw = std::thread::hardware_concurrency();
+				auto const count = hw > 1 ? hw - 1 : 0;
+				threads_.reserve(count);
+				for (unsigned index = 0; index < count; ++index)
+					threads_.emplace_back([this] { run(); });
+			}
+
+			~pool() {
+				{
+					std::lock_guard lock{m_};
+					done_ = true;
+				}
+				cv_.notify_all();
+				for (auto& thread : threads_)
+					thread.join();
+			}
+
+			std::size_t size() const noexcept { return threads_.size() + 1; }
+
+			void execute(job& work) {
+				{
+					std::lock_guard lock{m_};
+					jobs_.push_back(&work);
+				}
+				cv_.notify_all();
+
+				auto const ran = claim(work);
+
+				std::unique_lock lock{m_};
+				work.done += ran;
+				work.finished.wait(lock, [&] {
+					return work.done == work.count && !work.workers;
+				});
+				auto it = std::find(jobs_.begin(), jobs_.end(), &work);
+				if (it != jobs_.end()) jobs_.erase(it);
+			}
+
+		private:
+			static std::size_t claim(job& work) {
+				std::size_t ran{};
+				while (true) {
+					auto const index = work.next.fetch_add(1);
+					if (index >= work.count) break;
+					(*work.task)(index);
+					++ran;
+				}
+				return ran;
+			}
+
+			void run() {
+				std::unique_lock lock{m_};
+				while (true) {
+					cv_.wait(lock, [this] { return done_ || !jobs_.empty(); });
+					if (done_) break;
+
+					auto work = jobs_.front();
+					if (work->next.load() >= work->count) {
+						// everything is claimed, only the owner is left
+						jobs_.pop_front();
+						continue;
+					}
+
+					++work->workers;
+					lock.unlock();
+					auto const ran = claim(*work);
+					lock.lock();
+					work->done += ran;
+					--work->workers;
+					if (work->done == work->count && !work->workers)
+						work->finished.notify_all();
+				}
+			}
+
+			std::mutex m_{};
+			std::condition_variable cv_{};
+			std::deque<job*> jobs_{};
+			std::vector<std::thread> threads_{};
+			bool done_{false};
+		};
+
+		pool& workers() {
+			static pool instance{};
+			return instance;
+		}
+	}  // namespace
+
+	std::size_t concurrency() noexcept { return workers().size(); }
+
+	void parallel_for(std::size_t count,
+	                  std::function<void(std::size_t)> const& task) {
+		if (!count) return;
+		if (count == 1) {
+			task(0);
+			return;
+		}
+
+		job work{};
+		work.task = &task;
+		work.count = count;
+		workers().execute(work);
+	}
+
+	void parallel_for_ordered(std::size_t count,
+	                          std::function<void(std::size_t)> const& task,
+	                          std::function<void(std::size_t)> const& emit) {
+		std::mutex m{};
+		std::vector<bool> ready(count);
+		std::size_t next{};
+		bool emitting{false};
+
+		parallel_for(count, [&](std::size_t index) {
+			task(index);
+
+			std::unique_lock lock{m};
+			ready[index] = true;
+			// whoever emits, picks up the tasks finished in the meantime
+			if (emitting) return;
+			emitting = true;
+			while (next < count && ready[next]) {
+				auto const current = next++;
+				lock.unlock();
+				emit(current);
+				lock.lock();
+			}
+			emitting = false;
+		});
+	}
+}  // namespace arch::impl
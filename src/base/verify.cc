@@ -0,0 +1,92 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include <arch/base/verify.hh>
+#include <atomic>
+#include <deque>
+#include <thread>
+#include "background.hh"
+
+namespace arch::base {
+	namespace {
+		std::atomic<verify> default_verify_{verify::immediate};
+	}
+
+	verify default_verify() noexcept { return default_verify_.load(); }
+
+	void set_default_verify(verify policy) noexcept {
+		default_verify_.store(policy);
+	}
+}  // namespace arch::base
+
+namespace arch::impl {
+	namespace {
+		class worker {
+		public:
+			~worker() {
+				{
+					std::lock_guard lock{m_};
+					done_ = true;
+				}
+				cv_.notify_one();
+				if (thread_.joinable()) thread_.join();
+			}
+
+			void push(std::function<void()> task) {
+				{
+					std::lock_guard lock{m_};
+					tasks_.push_back(std::move(task));
+					if (!thread_.joinable()) thread_ = std::thread{[this] { run(); }};
+				}
+				cv_.notify_one();
+			}
+
+		private:
+			void run() {
+				std::unique_lock lock{m_};
+				while (true) {
+					cv_.wait(lock, [this] { return done_ || !tasks_.empty(); });
+					if (tasks_.empty()) break;
+
+					auto task = std::move(tasks_.front());
+					tasks_.pop_front();
+					lock.unlock();
+					task();
+					task = nullptr;
+					lock.lock();
+				}
+			}
+
+			std::mutex m_{};
+			std::condition_variable cv_{};
+			std::deque<std::function<void()>> tasks_{};
+			std::thread thread_{};
+			bool done_{false};
+		};
+
+		worker& verification_thread() {
+			static worker instance{};
+			return instance;
+		}
+	}  // namespace
+
+	void background_lane::post(std::function<void()> task) {
+		{
+			std::unique_lock lock{m_};
+			cv_.wait(lock, [this] { return pending_ < max_pending; });
+			++pending_;
+		}
+
+		verification_thread().push([this, task = std::move(task)] {
+			task();
+			std::lock_guard lock{m_};
+			--pending_;
+			cv_.notify_all();
+		});
+	}
+
+	void background_lane::drain() {
+		std::unique_lock lock{m_};
+		cv_.wait(lock, [this] { return !pending_; });
+	}
+}  // namespace arch::impl
@@ -3,6 +3,7 @@
 
 #include "arch/bzlib.hh"
 #include <limits>
+#include "compress_impl.hh"
 #include "decompress_impl.hh"
 
 namespace arch::impl {
@@ -19,6 +20,23 @@ namespace arch::impl {
 			return ret == BZ_STREAM_END;
 		}
 	};
+
+	template <>
+	struct encoder_traits<bz_stream> : stream_traits_base<bz_stream> {
+		static inline int encode(bz_stream* stream,
+		                         base::flush_mode mode) noexcept {
+			static constexpr int action[] = {BZ_RUN, BZ_FLUSH, BZ_FINISH};
+			return BZ2_bzCompress(stream, action[static_cast<int>(mode)]);
+		}
+
+		static inline constexpr bool ok(int ret) noexcept {
+			return ret == BZ_RUN_OK || ret == BZ_FLUSH_OK ||
+			       ret == BZ_FINISH_OK;
+		}
+		static inline constexpr bool stream_end(int ret) noexcept {
+			return ret == BZ_STREAM_END;
+		}
+	};
 }  // namespace arch::impl
 
 namespace arch::bzlib {
@@ -34,6 +52,24 @@ namespace arch::bzlib {
 	std::pair<size_t, size_t> decompressor::decompress(
 	    std::span<std::byte> input,
 	    std::span<std::byte> output) {
-		return impl::decompress(input, output, bz_);
+		return impl::decompress(input, output, bz_, eof_, damaged_);
+	}
+
+	compressor::compressor(int level) {
+		auto const err = BZ2_bzCompressInit(&bz_, level, 0, 0);
+		is_initialised_ = err == BZ_OK;
+		failed_ = !is_initialised_;
+	}
+
+	compressor::~compressor() {
+		if (is_initialised_) BZ2_bzCompressEnd(&bz_);
+	}
+
+	std::pair<size_t, size_t> compressor::compress(
+	    std::span<std::byte const> input,
+	    std::span<std::byte> output,
+	    base::flush_mode mode) {
+		if (failed_ || finished_) return {};
+		return impl::compress(input, output, bz_, mode, finished_, failed_);
 	}
 }  // namespace arch::bzlib
@@ -24,4 +24,19 @@ namespace arch {
 		static constexpr unsigned char magic[] = {Chars...};
 		return check_signature(file, magic, offset);
 	}
-}  // namespace arch
\ No newline at end of file
+
+	template <size_t N>
+	inline bool check_signature(std::span<std::byte const> prefix,
+	                            unsigned char const (&magic)[N],
+	                            size_t offset = 0) {
+		return prefix.size() >= offset + N &&
+		       !std::memcmp(prefix.data() + offset, magic, N);
+	}
+
+	template <unsigned char... Chars>
+	inline bool check_signature(std::span<std::byte const> prefix,
+	                            size_t offset = 0) {
+		static constexpr unsigned char magic[] = {Chars...};
+		return check_signature(prefix, magic, offset);
+	}
+}  // namespace arch
@@ -0,0 +1,64 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <arch/base/compressor.hh>
+#include "decompress_impl.hh"
+
+namespace arch::impl {
+	// Specialized next to the stream_traits of the same library, with
+	// encode(Stream*, base::flush_mode), ok(), stream_end() and
+	// recoverable().
+	template <typename Stream>
+	struct encoder_traits;
+
+	template <typename Stream>
+	std::pair<size_t, size_t> compress(std::span<std::byte const> input,
+	                                   std::span<std::byte> output,
+	                                   Stream& stream,
+	                                   base::flush_mode mode,
+	                                   bool& finished,
+	                                   bool& failed) {
+		// none of the libraries write to the input, they only miss the const
+		auto const writable =
+		    std::span{const_cast<std::byte*>(input.data()), input.size()};
+		stream_stats<0> in{writable, stream};
+		stream_stats<1> out{output, stream};
+
+		using traits = encoder_traits<Stream>;
+
+		while (true) {
+			in.update_avail(stream);
+			out.update_avail(stream);
+
+			if (!stream.avail_out) break;
+
+			// the flush may only be requested with the last chunk of input
+			auto const action = in.length ? base::flush_mode::none : mode;
+
+			auto const avail_in = stream.avail_in;
+			auto const avail_out = stream.avail_out;
+
+			auto const res = traits::encode(&stream, action);
+			if (traits::stream_end(res)) {
+				if (action == base::flush_mode::finish) finished = true;
+				break;
+			}
+			if (!traits::ok(res) && !traits::recoverable(res)) {
+				failed = true;
+				break;
+			}
+
+			// all the input is consumed (and flushed, if requested), as there
+			// is still room for more output
+			if (!stream.avail_in && !in.length && stream.avail_out) break;
+			if (stream.avail_in == avail_in && stream.avail_out == avail_out)
+				break;
+		}
+
+		in.on_chunk_read(stream);
+		out.on_chunk_read(stream);
+		return {out.used, in.used};
+	}
+}  // namespace arch::impl
@@ -4,6 +4,7 @@
 #pragma once
 
 #include <cstddef>
+#include <limits>
 #include <span>
 
 namespace arch::impl {
@@ -45,6 +46,17 @@ namespace arch::impl {
 		static inline constexpr bool meta_data(Stream*, ResultInt) noexcept {
 			return false;
 		}
+
+		template <typename ResultInt>
+		static inline constexpr bool recoverable(ResultInt) noexcept {
+			return false;
+		}
+
+		// true, if the library may still hold decoded data it could not
+		// write out, even with all the input taken
+		static inline constexpr bool pending(Stream const&) noexcept {
+			return false;
+		}
 	};
 
 	template <typename Stream>
@@ -105,7 +117,9 @@ namespace arch::impl {
 	template <typename Stream>
 	std::pair<size_t, size_t> decompress(std::span<std::byte> input,
 	                                     std::span<std::byte> output,
-	                                     Stream& stream) {
+	                                     Stream& stream,
+	                                     bool& eof,
+	                                     bool& damaged) {
 		stream_stats<0> in{input, stream};
 		stream_stats<1> out{output, stream};
 
@@ -115,12 +129,17 @@ namespace arch::impl {
 			in.update_avail(stream);
 			out.update_avail(stream);
 
-			if (!stream.avail_in || !stream.avail_out) break;
+			if (!stream.avail_out) break;
+			if (!stream.avail_in && !traits::pending(stream)) break;
 
 			auto const res = traits::decompress(&stream);
 			if (traits::meta_data(&stream, res)) continue;
-			if (!traits::ok(res) && !traits::stream_end(res)) break;
+			if (!traits::ok(res) && !traits::stream_end(res)) {
+				damaged = !traits::recoverable(res);
+				break;
+			}
 
+			if (traits::stream_end(res)) eof = true;
 			if (traits::stream_end(res) || in.empty(stream) ||
 			    out.empty(stream)) {
 				in.on_chunk_read(stream);
@@ -131,4 +150,41 @@ namespace arch::impl {
 
 		return {out.used, in.used};
 	}
+
+	// Decodes one complete stream into an output of known size, asking the
+	// library to finish in as few calls as possible (only the inputs and
+	// outputs larger than the avail_* type need more than one).
+	template <typename Stream>
+	bool decompress_all(std::span<std::byte> input,
+	                    std::span<std::byte> output,
+	                    Stream& stream,
+	                    size_t& used) {
+		stream_stats<0> in{input, stream};
+		stream_stats<1> out{output, stream};
+
+		using traits = stream_traits<Stream>;
+
+		bool finished = false;
+		while (true) {
+			in.update_avail(stream);
+			out.update_avail(stream);
+
+			auto const avail_in = stream.avail_in;
+			auto const avail_out = stream.avail_out;
+
+			auto const res = traits::finish(&stream);
+			if (traits::stream_end(res)) {
+				finished = true;
+				break;
+			}
+			if (!traits::ok(res) && !traits::recoverable(res)) break;
+			if (stream.avail_in == avail_in && stream.avail_out == avail_out)
+				break;
+		}
+
+		in.on_chunk_read(stream);
+		out.on_chunk_read(stream);
+		used = in.used;
+		return finished && out.used == output.size();
+	}
 }  // namespace arch::impl
\ No newline at end of file
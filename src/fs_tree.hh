@@ -0,0 +1,35 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <arch/base/fs.hh>
+#include <ctime>
+#include <functional>
+#include <string>
+
+namespace arch::impl {
+	// What the writers' add_file() takes from the filesystem
+	struct fs_member {
+		fs::file_type type{};
+		fs::perms permissions{};
+		time_t mtime{};
+		// regular files only
+		size_t size{};
+		// symlinks only
+		std::string linkname{};
+	};
+
+	// False, if the path cannot be read or is not a regular file, a
+	// directory or a symlink.
+	bool stat_member(fs::path const& path, fs_member& result);
+
+	// Calls add(path, name) for everything below root, in name order, so
+	// the result does not depend on the order of the directory listing.
+	// Directories come before their contents; symlinks to directories are
+	// not followed. Stops at the first add() returning false.
+	bool walk_tree(
+	    fs::path const& root,
+	    std::string const& prefix,
+	    std::function<bool(fs::path const&, std::string const&)> const& add);
+}  // namespace arch::impl
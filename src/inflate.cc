@@ -0,0 +1,117 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include <arch/inflate.hh>
+#include <arch/zlib.hh>
+#include <atomic>
+#include <cstdlib>
+#include "inflate/backends.hh"
+
+namespace arch::inflate {
+	namespace impl {
+		bool zlib_supported() noexcept { return true; }
+
+		base::decompressor::ptr zlib_make() {
+			return std::make_unique<zlib::decompressor>(-MAX_WBITS);
+		}
+	}  // namespace impl
+
+	namespace {
+		constexpr backend all_backends[] = {
+#ifdef LIBARCH_HAS_LIBDEFLATE
+		    {"libdeflate", impl::libdeflate_supported, nullptr,
+		     impl::libdeflate_decode_all},
+#endif
+#ifdef LIBARCH_HAS_ISAL
+		    {"isal", impl::isal_supported, impl::isal_make,
+		     impl::isal_decode_all},
+#endif
+#ifdef LIBARCH_HAS_ZLIB_NG
+		    {"zlib-ng", impl::zlib_ng_supported, impl::zlib_ng_make,
+		     impl::zlib_ng_decode_all},
+#endif
+		    {"zlib", impl::zlib_supported, impl::zlib_make,
+		     impl::zlib_decode_all},
+		};
+
+		backend const* usable(std::string_view name) noexcept {
+			auto const* result = find(name);
+			if (result && !result->supported()) result = nullptr;
+			return result;
+		}
+
+		template <typename Member>
+		backend const* automatic(Member backend::*member) noexcept {
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable : 4996)  // getenv
+#endif
+			if (auto const* env = std::getenv("LIBARCH_INFLATE"); env) {
+				auto const* result = usable(env);
+				if (result && result->*member) return result;
+			}
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+			for (auto const& candidate : all_backends) {
+				if (candidate.*member && candidate.supported())
+					return &candidate;
+			}
+
+			// the last one is stock zlib, which is always supported
+			return &all_backends[std::size(all_backends) - 1];
+		}
+
+		std::atomic<backend const*>& streaming() noexcept {
+			static std::atomic<backend const*> instance{
+			    automatic(&backend::make)};
+			return instance;
+		}
+
+		std::atomic<backend const*>& buffers() noexcept {
+			static std::atomic<backend const*> instance{
+			    automatic(&backend::decode_all)};
+			return instance;
+		}
+	}  // namespace
+
+	std::span<backend const> backends() noexcept { return all_backends; }
+
+	backend const* find(std::string_view name) noexcept {
+		for (auto const& candidate : all_backends) {
+			if (candidate.name == name) return &candidate;
+		}
+		return nullptr;
+	}
+
+	bool select(std::string_view name) noexcept {
+		if (name.empty() || name == "auto") {
+			streaming().store(automatic(&backend::make));
+			buffers().store(automatic(&backend::decode_all));
+			return true;
+		}
+
+		auto const* result = usable(name);
+		if (!result) return false;
+		if (result->make) streaming().store(result);
+		buffers().store(result);
+		return true;
+	}
+
+	backend const& selected() noexcept { return *streaming().load(); }
+
+	backend const& selected_for_buffers() noexcept {
+		return *buffers().load();
+	}
+
+	base::decompressor::ptr make_decompressor() {
+		return selected().make();
+	}
+
+	bool decode_all(std::span<std::byte const> input,
+	                std::span<std::byte> output,
+	                size_t& used) {
+		return selected_for_buffers().decode_all(input, output, used);
+	}
+}  // namespace arch::inflate
@@ -0,0 +1,37 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <arch/base/decompressor.hh>
+
+namespace arch::inflate::impl {
+	bool zlib_supported() noexcept;
+	base::decompressor::ptr zlib_make();
+	bool zlib_decode_all(std::span<std::byte const> input,
+	                     std::span<std::byte> output,
+	                     size_t& used);
+
+#ifdef LIBARCH_HAS_ZLIB_NG
+	bool zlib_ng_supported() noexcept;
+	base::decompressor::ptr zlib_ng_make();
+	bool zlib_ng_decode_all(std::span<std::byte const> input,
+	                        std::span<std::byte> output,
+	                        size_t& used);
+#endif
+
+#ifdef LIBARCH_HAS_ISAL
+	bool isal_supported() noexcept;
+	base::decompressor::ptr isal_make();
+	bool isal_decode_all(std::span<std::byte const> input,
+	                     std::span<std::byte> output,
+	                     size_t& used);
+#endif
+
+#ifdef LIBARCH_HAS_LIBDEFLATE
+	bool libdeflate_supported() noexcept;
+	bool libdeflate_decode_all(std::span<std::byte const> input,
+	                           std::span<std::byte> output,
+	                           size_t& used);
+#endif
+}  // namespace arch::inflate::impl
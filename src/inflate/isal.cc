@@ -0,0 +1,104 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#ifdef LIBARCH_HAS_ISAL
+
+#include <isa-l/igzip_lib.h>
+#include <limits>
+#include "decompress_impl.hh"
+#include "inflate/backends.hh"
+
+namespace arch::impl {
+	template <>
+	struct stream_traits<inflate_state> : stream_traits_base<inflate_state> {
+		// igzip reports the end of a stream through the block state, not
+		// through the return value
+		static constexpr int finished = std::numeric_limits<int>::max();
+
+		static inline int decompress(inflate_state* state) noexcept {
+			auto const ret = isal_inflate(state);
+			if (ret == ISAL_DECOMP_OK &&
+			    state->block_state == ISAL_BLOCK_FINISH)
+				return finished;
+			return ret;
+		}
+
+		static inline constexpr bool ok(int ret) noexcept {
+			return ret == ISAL_DECOMP_OK || ret == ISAL_END_INPUT ||
+			       ret == ISAL_OUT_OVERFLOW;
+		}
+		static inline constexpr bool stream_end(int ret) noexcept {
+			return ret == finished;
+		}
+	};
+}  // namespace arch::impl
+
+namespace arch::inflate::impl {
+	namespace {
+		class decompressor final : public base::decompressor {
+		public:
+			decompressor() {
+				isal_inflate_init(&state_);
+				state_.crc_flag = ISAL_DEFLATE;
+			}
+			bool eof() const noexcept final { return eof_; }
+			bool damaged() const noexcept final { return damaged_; }
+			std::pair<size_t, size_t> decompress(
+			    std::span<std::byte> input,
+			    std::span<std::byte> output) final {
+				return arch::impl::decompress(input, output, state_, eof_,
+				                              damaged_);
+			}
+
+		private:
+			bool eof_{false};
+			bool damaged_{false};
+			inflate_state state_{};
+		};
+	}  // namespace
+
+	bool isal_supported() noexcept {
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+		// without AVX2, igzip is not faster than zlib-ng
+		return __builtin_cpu_supports("avx2");
+#else
+		return true;
+#endif
+	}
+
+	base::decompressor::ptr isal_make() {
+		return std::make_unique<decompressor>();
+	}
+
+	bool isal_decode_all(std::span<std::byte const> input,
+	                     std::span<std::byte> output,
+	                     size_t& used) {
+		static constexpr auto uint_max =
+		    static_cast<size_t>(std::numeric_limits<uint32_t>::max());
+		if (input.size() > uint_max || output.size() > uint_max) {
+			// stateless inflate takes 32-bit sizes only
+			decompressor stream{};
+			auto const [decompressed, read] =
+			    stream.decompress({const_cast<std::byte*>(input.data()),
+			                       input.size()},
+			                      output);
+			used = read;
+			return stream.eof() && decompressed == output.size();
+		}
+
+		thread_local inflate_state state{};
+		isal_inflate_init(&state);
+		state.crc_flag = ISAL_DEFLATE;
+		state.next_in =
+		    reinterpret_cast<uint8_t*>(const_cast<std::byte*>(input.data()));
+		state.avail_in = static_cast<uint32_t>(input.size());
+		state.next_out = reinterpret_cast<uint8_t*>(output.data());
+		state.avail_out = static_cast<uint32_t>(output.size());
+
+		auto const ret = isal_inflate_stateless(&state);
+		used = input.size() - state.avail_in;
+		return ret == ISAL_DECOMP_OK && !state.avail_out;
+	}
+}  // namespace arch::inflate::impl
+
+#endif  // LIBARCH_HAS_ISAL
@@ -0,0 +1,40 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#ifdef LIBARCH_HAS_LIBDEFLATE
+
+#include <libdeflate.h>
+#include <memory>
+#include "inflate/backends.hh"
+
+namespace arch::inflate::impl {
+	namespace {
+		struct decompressor_free {
+			void operator()(libdeflate_decompressor* ptr) {
+				libdeflate_free_decompressor(ptr);
+			}
+		};
+	}  // namespace
+
+	bool libdeflate_supported() noexcept {
+		// libdeflate selects its kernels at runtime by itself
+		return true;
+	}
+
+	bool libdeflate_decode_all(std::span<std::byte const> input,
+	                           std::span<std::byte> output,
+	                           size_t& used) {
+		thread_local std::unique_ptr<libdeflate_decompressor,
+		                             decompressor_free>
+		    decompressor{libdeflate_alloc_decompressor()};
+		if (!decompressor) return false;
+
+		size_t actual_out{};
+		auto const ret = libdeflate_deflate_decompress_ex(
+		    decompressor.get(), input.data(), input.size(), output.data(),
+		    output.size(), &used, &actual_out);
+		return ret == LIBDEFLATE_SUCCESS && actual_out == output.size();
+	}
+}  // namespace arch::inflate::impl
+
+#endif  // LIBARCH_HAS_LIBDEFLATE
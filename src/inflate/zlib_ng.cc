@@ -0,0 +1,95 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#ifdef LIBARCH_HAS_ZLIB_NG
+
+#include <zlib-ng.h>
+#include <limits>
+#include "decompress_impl.hh"
+#include "inflate/backends.hh"
+
+namespace arch::impl {
+	template <>
+	struct stream_traits<zng_stream> : stream_traits_base<zng_stream> {
+		static inline int32_t decompress(zng_stream* stream) noexcept {
+			return zng_inflate(stream, Z_SYNC_FLUSH);
+		}
+
+		static inline int32_t finish(zng_stream* stream) noexcept {
+			return zng_inflate(stream, Z_FINISH);
+		}
+
+		static inline constexpr bool ok(int32_t ret) noexcept {
+			return ret == Z_OK;
+		}
+		static inline constexpr bool stream_end(int32_t ret) noexcept {
+			return ret == Z_STREAM_END;
+		}
+		static inline constexpr bool recoverable(int32_t ret) noexcept {
+			return ret == Z_BUF_ERROR;
+		}
+	};
+}  // namespace arch::impl
+
+namespace arch::inflate::impl {
+	namespace {
+		class decompressor final : public base::decompressor {
+		public:
+			decompressor() {
+				is_initialised_ = zng_inflateInit2(&z_, -MAX_WBITS) == Z_OK;
+			}
+			~decompressor() {
+				if (is_initialised_) zng_inflateEnd(&z_);
+			}
+			bool eof() const noexcept final { return eof_; }
+			bool damaged() const noexcept final { return damaged_; }
+			std::pair<size_t, size_t> decompress(
+			    std::span<std::byte> input,
+			    std::span<std::byte> output) final {
+				return arch::impl::decompress(input, output, z_, eof_,
+				                              damaged_);
+			}
+
+		private:
+			bool eof_{false};
+			bool damaged_{false};
+			bool is_initialised_{false};
+			zng_stream z_{};
+		};
+	}  // namespace
+
+	bool zlib_ng_supported() noexcept {
+		// zlib-ng selects its kernels at runtime by itself
+		return true;
+	}
+
+	base::decompressor::ptr zlib_ng_make() {
+		return std::make_unique<decompressor>();
+	}
+
+	bool zlib_ng_decode_all(std::span<std::byte const> input,
+	                        std::span<std::byte> output,
+	                        size_t& used) {
+		struct raw_inflater {
+			raw_inflater() {
+				is_initialised = zng_inflateInit2(&z, -MAX_WBITS) == Z_OK;
+			}
+			~raw_inflater() {
+				if (is_initialised) zng_inflateEnd(&z);
+			}
+
+			bool is_initialised{false};
+			zng_stream z{};
+		};
+
+		thread_local raw_inflater inflater{};
+		if (!inflater.is_initialised || zng_inflateReset(&inflater.z) != Z_OK)
+			return false;
+
+		auto const writable = std::span{const_cast<std::byte*>(input.data()),
+		                                input.size()};
+		return arch::impl::decompress_all(writable, output, inflater.z, used);
+	}
+}  // namespace arch::inflate::impl
+
+#endif  // LIBARCH_HAS_ZLIB_NG
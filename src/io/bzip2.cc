@@ -13,8 +13,13 @@ namespace arch::io {
 		return check_signature<'B', 'Z', 'h'>(file);
 	}
 
-	io::seekable::ptr bzip2::wrap(io::seekable::ptr&& file) {
-		return wrap_impl<bzip2>(std::move(file), wrapper_tag{});
+	bool bzip2::is_valid(std::span<std::byte const> prefix) {
+		return check_signature<'B', 'Z', 'h'>(prefix);
+	}
+
+	io::seekable::ptr bzip2::wrap(io::seekable::ptr&& file,
+	                              open_options const& opts) {
+		return wrap_impl<bzip2>(std::move(file), opts, wrapper_tag{});
 	}
 
 	base::decompressor::ptr bzip2::make_decompressor() {
@@ -23,26 +23,39 @@ namespace arch::io {
 		if (buffer.empty() || eof()) return 0;
 
 		size_t result{};
-
-		std::vector<std::byte> raw(10 * 1024 * 1024);
+		auto const raw = input_buffer();
 
 		while (true) {
 			if (result == buffer.size()) break;
 
 			if (decompressor_->eof()) reset_decompressor();
 
-			auto const read = read_lowlevel({raw.data(), raw.size()});
+			auto const read = read_lowlevel(raw);
 			auto const [decompressed, used] = decompressor_->decompress(
-			    {raw.data(), read}, buffer.subspan(result));
+			    raw.first(read), buffer.subspan(result));
 
-			if (used < read) putback({raw.data() + used, read - used});
+			if (used < read) putback(raw.subspan(used, read - used));
 
-			if (!decompressed) break;
+			if (decompressor_->damaged()) {
+				mark_damaged();
+				break;
+			}
 
-			if (decompressed) {
-				result += decompressed;
-				move_by(decompressed);
+			// bzip2 and xz verify their streams internally, reaching the end
+			// means the checks were passed
+			if (decompressor_->eof() && policy_ != verify::trusted)
+				checked_ = true;
+
+			if (!decompressed) {
+				// the end of stream could have been found without producing
+				// anything new; give the next stream a chance. bzip2 also
+				// takes in a whole block, before anything comes out
+				if ((decompressor_->eof() || used) && read) continue;
+				break;
 			}
+
+			result += decompressed;
+			move_by(decompressed);
 		}
 
 		if (result) return result;
@@ -81,6 +94,11 @@ namespace arch::io {
 
 	std::size_t decoding_file::tell() const { return pos_; }
 
+	verify_result decoding_file::verification() {
+		if (damaged_) return verify_result::damaged;
+		return checked_ ? verify_result::valid : verify_result::unchecked;
+	}
+
 	void decoding_file::rewind() {
 		file_->seek(0);
 		eof_ = false;
@@ -90,6 +108,7 @@ namespace arch::io {
 	}
 
 	void decoding_file::reset_decompressor() {
+		if (decompressor_ && decompressor_->reset()) return;
 		decompressor_ = make_decompressor();
 	}
 
@@ -97,6 +116,11 @@ namespace arch::io {
 		pos_ += decompressed;
 	}
 
+	void decoding_file::reposition(size_t pos) noexcept {
+		pos_ = pos;
+		eof_ = false;
+	}
+
 	size_t decoding_file::read_lowlevel(std::span<std::byte> buffer) {
 		size_t read{}, buffered{};
 
@@ -128,6 +152,14 @@ namespace arch::io {
 		return read_lowlevel(buffer) == buffer.size();
 	}
 
+	std::span<std::byte> decoding_file::input_buffer() {
+		// anything not used by the decompressor goes back to putback_, so
+		// larger chunks would only be copied back and forth
+		static constexpr size_t input_size = 64 * 1024;
+		if (input_.empty()) input_.resize(input_size);
+		return input_;
+	}
+
 	void decoding_file::eof_reached() noexcept {
 		eof_ = true;
 		size_ = pos_;
@@ -0,0 +1,167 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include <arch/io/encoding_file.hh>
+#include <algorithm>
+#include <utility>
+
+namespace arch::io {
+	std::unique_ptr<encoding_file> encoding_file::wrap(
+	    writeable::ptr&& file,
+	    base::compressor::ptr&& compressor,
+	    size_t buffer_size) {
+		if (!file || !compressor || compressor->failed()) return {};
+		return std::make_unique<encoding_file>(wrapper_tag{}, std::move(file),
+		                                       std::move(compressor),
+		                                       buffer_size);
+	}
+
+	encoding_file::encoding_file(wrapper_tag,
+	                             writeable::ptr&& file,
+	                             base::compressor::ptr&& compressor,
+	                             size_t buffer_size)
+	    : file_{std::move(file)}
+	    , compressor_{std::move(compressor)}
+	    , buffer_(buffer_size ? buffer_size : default_buffer_size) {}
+
+	encoding_file::~encoding_file() { close(); }
+
+	void encoding_file::close() {
+		if (!file_) return;
+		finish();
+		file_->close();
+		file_.reset();
+	}
+
+	io::status const& encoding_file::file_status() const {
+		return file_->file_status();
+	}
+
+	io::status const& encoding_file::linked_status() const {
+		return file_->linked_status();
+	}
+
+	fs::path const& encoding_file::linkname() const {
+		return file_->linkname();
+	}
+
+	std::size_t encoding_file::write(std::span<std::byte const> data) {
+		if (failed_ || !file_ || compressor_->finished()) return 0;
+
+		size_t consumed{};
+		while (consumed < data.size()) {
+			auto const [produced, used] =
+			    encode(data.subspan(consumed), base::flush_mode::none);
+			fill_ += produced;
+			consumed += used;
+
+			if (compressor_->failed()) {
+				failed_ = true;
+				break;
+			}
+
+			if (fill_ == buffer_.size()) {
+				if (!drain()) break;
+			} else if (!used)
+				break;
+		}
+
+		pos_ += consumed;
+		return consumed;
+	}
+
+	bool encoding_file::adapt(int min_level, int max_level, int start_level) {
+		if (min_level > max_level) return false;
+
+		auto const level = std::clamp(start_level, min_level, max_level);
+		if (!compressor_->set_level(level)) return false;
+
+		adaptive_ = true;
+		min_level_ = min_level;
+		max_level_ = max_level;
+		level_ = level;
+		encoder_time_ = {};
+		return true;
+	}
+
+	std::size_t encoding_file::seek(std::size_t) { return pos_; }
+
+	std::size_t encoding_file::seek_end() { return pos_; }
+
+	std::size_t encoding_file::tell() const { return pos_; }
+
+	bool encoding_file::flush() {
+		if (failed_ || !file_ || compressor_->finished()) return false;
+		return flush_impl(base::flush_mode::sync);
+	}
+
+	bool encoding_file::finish() {
+		if (failed_ || !file_) return false;
+		if (compressor_->finished()) return true;
+		return flush_impl(base::flush_mode::finish);
+	}
+
+	bool encoding_file::flush_impl(base::flush_mode mode) {
+		while (true) {
+			auto const [produced, used] = encode({}, mode);
+			fill_ += produced;
+
+			if (compressor_->failed()) {
+				failed_ = true;
+				return false;
+			}
+
+			auto const done = mode == base::flush_mode::finish
+			                      ? compressor_->finished()
+			                      : fill_ < buffer_.size();
+			if (!drain()) return false;
+			if (done) return true;
+			if (!produced) {
+				// no room was made and nothing came out
+				failed_ = true;
+				return false;
+			}
+		}
+	}
+
+	std::pair<size_t, size_t> encoding_file::encode(
+	    std::span<std::byte const> data,
+	    base::flush_mode mode) {
+		auto const output = std::span{buffer_}.subspan(fill_);
+		if (!adaptive_) return compressor_->compress(data, output, mode);
+
+		auto const start = clock::now();
+		auto const result = compressor_->compress(data, output, mode);
+		encoder_time_ += clock::now() - start;
+		return result;
+	}
+
+	bool encoding_file::drain() {
+		if (!fill_) return true;
+
+		auto const start = adaptive_ ? clock::now() : clock::time_point{};
+		auto const written = file_->write({buffer_.data(), fill_});
+		bytes_out_ += written;
+		if (written != fill_) {
+			failed_ = true;
+			return false;
+		}
+
+		if (adaptive_) adjust_level(clock::now() - start);
+		fill_ = 0;
+		return true;
+	}
+
+	void encoding_file::adjust_level(clock::duration sink_time) {
+		// a quarter of difference either way, before the level moves
+		auto const encoder_time = std::exchange(encoder_time_, {});
+		auto next = level_;
+		if (sink_time * 4 > encoder_time * 5)
+			++next;
+		else if (encoder_time * 4 > sink_time * 5)
+			--next;
+
+		next = std::clamp(next, min_level_, max_level_);
+		if (next != level_ && compressor_->set_level(next)) level_ = next;
+	}
+}  // namespace arch::io
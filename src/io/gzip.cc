@@ -1,8 +1,9 @@
 // Copyright (c) 2020 midnightBITS
 // This code is licensed under MIT license (see LICENSE for details)
 
+#include <arch/inflate.hh>
 #include <arch/io/gzip.hh>
-#include <arch/zlib.hh>
+#include <cstring>
 #include "check_signature.hh"
 
 namespace arch::io {
@@ -22,78 +23,148 @@ namespace arch::io {
 		constexpr uint8_t FEXTRA = 4;
 		constexpr uint8_t FNAME = 8;
 		constexpr uint8_t FCOMMENT = 16;
+
+		struct GzipEof {
+			uint32_t crc;
+			uint32_t stream_size;
+		};
+		static_assert(sizeof(GzipEof) == 8);
+
+		// deflate cannot expand its input more than about 1032 times; a
+		// larger ISIZE is a lie, or a file better read in a stream
+		constexpr size_t max_deflate_ratio = 1032;
+
+		size_t skip_asciiz(std::span<std::byte const> input, size_t offset) {
+			while (offset < input.size() && input[offset] != std::byte{})
+				++offset;
+			return offset + 1;
+		}
+
+		// size of the member header at the start of the input, or 0
+		size_t header_size(std::span<std::byte const> input) {
+			Header hdr;
+			if (input.size() < sizeof(hdr)) return 0;
+			std::memcpy(&hdr, input.data(), sizeof(hdr));
+			if (hdr.magic != 0x8b1f || hdr.compression != 8) return 0;
+
+			size_t offset = sizeof(hdr);
+			if (hdr.file_flags & FEXTRA) {
+				uint16_t size{};
+				if (input.size() < offset + sizeof(size)) return 0;
+				std::memcpy(&size, input.data() + offset, sizeof(size));
+				offset += sizeof(size) + size;
+			}
+			if (hdr.file_flags & FNAME) offset = skip_asciiz(input, offset);
+			if (hdr.file_flags & FCOMMENT) offset = skip_asciiz(input, offset);
+			if (hdr.file_flags & FHCRC) offset += sizeof(uint16_t);
+
+			return offset < input.size() ? offset : 0;
+		}
 	}  // namespace
 
-	gzip::gzip(wrapper_tag) {}
+	gzip::gzip(wrapper_tag, verify policy) : check_{policy} {}
 
 	bool gzip::is_valid(io::seekable* file) {
 		// magic + deflate
 		return check_signature<0x1F, 0x8B, 0x08>(file);
 	}
 
-	io::seekable::ptr gzip::wrap(io::seekable::ptr&& file) {
-		return wrap_impl<gzip>(std::move(file), wrapper_tag{});
+	bool gzip::is_valid(std::span<std::byte const> prefix) {
+		return check_signature<0x1F, 0x8B, 0x08>(prefix);
+	}
+
+	io::seekable::ptr gzip::wrap(io::seekable::ptr&& file,
+	                             open_options const& opts) {
+		return wrap_impl<gzip>(std::move(file), opts, wrapper_tag{},
+		                       opts.integrity);
 	}
 
 	std::size_t gzip::read(std::span<std::byte> buffer) {
 		if (buffer.empty() || eof()) return 0;
 
 		size_t result{};
+		bool finished = false;
 
-		std::vector<std::byte> raw(32 * 1024);
-
-		while (true) {
-			if (result == buffer.size()) break;
+		auto const raw = input_buffer();
 
+		while (result < buffer.size()) {
 			if (decompressor()->eof()) {
-				if (!read_eof()) break;
+				// with verify::immediate, a CRC mismatch ends the stream here
+				if (!read_eof()) {
+					finished = true;
+					break;
+				}
 				new_member_ = true;
 				reset_decompressor();
 			}
 			if (new_member_) {
 				init_read();
 				if (!read_gzip_header()) {
-					eof_reached();
-					return 0;
+					finished = true;
+					break;
 				}
 				new_member_ = false;
 			}
 
-			auto const read = read_lowlevel({raw.data(), raw.size()});
+			auto const read = read_lowlevel(raw);
 			auto const [decompressed, used] = decompressor()->decompress(
-			    {raw.data(), read}, buffer.subspan(result));
-
-			if (used < read) putback({raw.data() + used, read - used});
+			    raw.first(read), buffer.subspan(result));
 
-			if (!decompressed) break;
+			if (used < read) putback(raw.subspan(used, read - used));
 
-			if (decompressed) {
-				static constexpr auto uint_max =
-				    static_cast<size_t>(std::numeric_limits<uInt>::max());
-
-				auto size = decompressed;
-				auto data = reinterpret_cast<Bytef*>(buffer.data());
-				while (size) {
-					auto chunk = std::min(size, uint_max);
-					crc32_ = crc32(crc32_, data, static_cast<uInt>(chunk));
-					size -= chunk;
-					data += chunk;
-				}
+			if (decompressor()->damaged()) {
+				mark_damaged();
+				finished = true;
+				break;
+			}
 
-				stream_size_ += decompressed;
-				result += decompressed;
-				move_by(decompressed);
+			if (!decompressed) {
+				if (decompressor()->eof() || used) continue;
+				break;
 			}
+
+			check_.update(buffer.subspan(result, decompressed));
+			result += decompressed;
+			move_by(decompressed);
 		}
 
-		if (result) return result;
+		if (result && !finished) return result;
 
 		eof_reached();
-		return 0;
+		return result;
+	}
+
+	verify_result gzip::verification() {
+		if (decoding_file::verification() == verify_result::damaged)
+			return verify_result::damaged;
+		return check_.result();
+	}
+
+	bool gzip::decode_all(std::span<std::byte const> input,
+	                      std::vector<std::byte>& output,
+	                      verify policy) {
+		auto const header = header_size(input);
+		if (!header || input.size() < header + sizeof(GzipEof)) return false;
+
+		GzipEof eof{};
+		std::memcpy(&eof, input.data() + input.size() - sizeof(eof),
+		            sizeof(eof));
+
+		auto const body =
+		    input.subspan(header, input.size() - header - sizeof(eof));
+		if (eof.stream_size / max_deflate_ratio > body.size()) return false;
+		output.resize(eof.stream_size);
+
+		size_t used{};
+		if (!inflate::decode_all(body, output, used) || used != body.size())
+			return false;
+
+		if (policy == verify::trusted) return true;
+		return zlib::crc32_update(::crc32(0, nullptr, 0), output) == eof.crc;
 	}
 
 	base::decompressor::ptr gzip::make_decompressor() {
-		return std::make_unique<zlib::decompressor>(-MAX_WBITS);
+		return inflate::make_decompressor();
 	}
 
 	void gzip::rewind() {
@@ -101,10 +172,7 @@ namespace arch::io {
 		new_member_ = true;
 	}
 
-	void gzip::init_read() {
-		crc32_ = crc32(0, nullptr, 0);
-		stream_size_ = 0;
-	}
+	void gzip::init_read() { check_.start(); }
 
 	bool gzip::read_gzip_header() {
 		Header hdr;
@@ -136,16 +204,11 @@ namespace arch::io {
 	}
 
 	bool gzip::read_eof() {
-		struct GzipEof {
-			uint32_t crc;
-			uint32_t stream_size;
-		} eof{};
-		static_assert(sizeof(GzipEof) == 8);
+		GzipEof eof{};
 
 		if (!read_exactly(as_bytes(eof))) return false;
 
-		if (eof.crc != crc32_) return false;
-		if (eof.stream_size != (stream_size_ & 0xffff'ffff)) return false;
+		if (!check_.finish(eof.crc, eof.stream_size)) return false;
 
 		char c = 0;
 		bool padding_eof = false;
@@ -0,0 +1,312 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include <arch/io/lz4.hh>
+#include <lz4.h>
+#include <algorithm>
+#include <cstring>
+#include "check_signature.hh"
+#include "parallel.hh"
+
+namespace arch::io {
+	namespace {
+		inline uint32_t read32(std::byte const* data) noexcept {
+			return static_cast<uint32_t>(data[0]) |
+			       (static_cast<uint32_t>(data[1]) << 8) |
+			       (static_cast<uint32_t>(data[2]) << 16) |
+			       (static_cast<uint32_t>(data[3]) << 24);
+		}
+
+		// upper bound of the decoded data kept between reads
+		constexpr size_t max_batch = 64 * 1024 * 1024;
+
+		struct block {
+			size_t offset{};
+			size_t size{};
+			size_t decoded{};
+			uint32_t checksum{};
+			bool stored{};
+			bool failed{};
+		};
+	}  // namespace
+
+	lz4::lz4(wrapper_tag) {}
+
+	bool lz4::is_valid(io::seekable* file) {
+		return check_signature<0x04, 0x22, 0x4D, 0x18>(file);
+	}
+
+	bool lz4::is_valid(std::span<std::byte const> prefix) {
+		return check_signature<0x04, 0x22, 0x4D, 0x18>(prefix);
+	}
+
+	io::seekable::ptr lz4::wrap(io::seekable::ptr&& file,
+	                            open_options const& opts) {
+		return wrap_impl<lz4>(std::move(file), opts, wrapper_tag{});
+	}
+
+	std::optional<uint64_t> lz4::content_size() const {
+		if (!content_size_known_) {
+			content_size_ = content_size(raw_file());
+			content_size_known_ = true;
+		}
+		return content_size_;
+	}
+
+	std::optional<uint64_t> lz4::content_size(io::seekable* file) {
+		// Walks the frames using only the headers and block sizes; nothing
+		// is decoded, or even read, from the blocks themselves. The file is
+		// left where it was found.
+		auto const position = file->tell();
+		uint64_t total{};
+		size_t offset{};
+		std::optional<uint64_t> result{};
+
+		while (true) {
+			std::byte header[arch::lz4::max_frame_header];
+			if (file->seek(offset) != offset) break;
+			auto const read = file->read(header);
+			if (!read) {
+				result = total;
+				break;
+			}
+			if (read < 8) break;
+
+			auto const magic = read32(header);
+			if (arch::lz4::is_skippable(magic)) {
+				offset += 8 + read32(header + 4);
+				continue;
+			}
+
+			auto const frame = arch::lz4::read_frame_header({header, read});
+			if (!frame || !frame->content_size) break;
+			total += *frame->content_size;
+
+			offset += frame->size;
+			std::byte word[4];
+			while (file->seek(offset) == offset &&
+			       file->read(word) == sizeof(word)) {
+				auto const size = read32(word);
+				offset += sizeof(word);
+				if (!size) break;
+				offset += (size & 0x7FFFFFFF) + (frame->block_checksum ? 4 : 0);
+			}
+			if (frame->content_checksum) offset += 4;
+		}
+
+		file->seek(position);
+		return result;
+	}
+
+	std::size_t lz4::read(std::span<std::byte> buffer) {
+		if (buffer.empty() || eof()) return 0;
+
+		size_t result{};
+		while (result < buffer.size()) {
+			if (batch_pos_ < batch_size_) {
+				auto const chunk =
+				    std::min(batch_size_ - batch_pos_, buffer.size() - result);
+				std::memcpy(buffer.data() + result, batch_.data() + batch_pos_,
+				            chunk);
+				batch_pos_ += chunk;
+				result += chunk;
+				move_by(chunk);
+				continue;
+			}
+
+			if (mode_ == mode::stream)
+				return result + decoding_file::read(buffer.subspan(result));
+
+			if (mode_ == mode::done) break;
+			if (mode_ == mode::frame ? !next_frame() : !next_blocks()) {
+				mode_ = mode::done;
+				break;
+			}
+		}
+
+		if (result) return result;
+
+		eof_reached();
+		return 0;
+	}
+
+	base::decompressor::ptr lz4::make_decompressor() {
+		return std::make_unique<arch::lz4::decompressor>(policy());
+	}
+
+	void lz4::rewind() {
+		mode_ = mode::frame;
+		batch_pos_ = 0;
+		batch_size_ = 0;
+		decoding_file::rewind();
+	}
+
+	bool lz4::next_frame() {
+		while (true) {
+			std::byte header[arch::lz4::max_frame_header];
+			auto const read = read_lowlevel({header, 4});
+			if (!read) return false;
+			if (read < 4) {
+				mark_damaged();
+				return false;
+			}
+
+			if (arch::lz4::is_skippable(read32(header))) {
+				std::byte length[4];
+				if (!read_exactly(length) || !skip_lowlevel(read32(length))) {
+					mark_damaged();
+					return false;
+				}
+				continue;
+			}
+
+			auto const rest = read_lowlevel({header + 4, sizeof(header) - 4});
+			auto const frame = arch::lz4::read_frame_header({header, rest + 4});
+			if (!frame) {
+				mark_damaged();
+				return false;
+			}
+
+			if (frame->size < rest + 4)
+				putback({header + frame->size, rest + 4 - frame->size});
+
+			if (!frame->independent_blocks || frame->dictionary) {
+				// linked blocks need everything decoded before them, which is
+				// what LZ4F does best
+				putback({header, frame->size});
+				mode_ = mode::stream;
+				return true;
+			}
+
+			frame_ = *frame;
+			content_hash_.reset();
+			mode_ = mode::blocks;
+			return true;
+		}
+	}
+
+	bool lz4::next_blocks() {
+		// Independent blocks are read in batches and decoded at the same
+		// time, each block into its own slot of the batch buffer.
+		auto const max_blocks =
+		    std::clamp(impl::concurrency() * 2, size_t{1},
+		               std::max(size_t{1}, max_batch / frame_.block_max));
+
+		std::vector<block> blocks{};
+		blocks.reserve(max_blocks);
+		packed_.clear();
+
+		bool frame_end = false;
+		std::byte word[4];
+		while (blocks.size() < max_blocks) {
+			if (!read_exactly(word)) {
+				mark_damaged();
+				return false;
+			}
+			auto const size = read32(word);
+			if (!size) {
+				frame_end = true;
+				break;
+			}
+
+			block next{};
+			next.offset = packed_.size();
+			next.size = size & 0x7FFFFFFF;
+			next.stored = (size & 0x80000000) != 0;
+			if (next.size > frame_.block_max) {
+				mark_damaged();
+				return false;
+			}
+
+			packed_.resize(next.offset + next.size);
+			if (!read_exactly({packed_.data() + next.offset, next.size}) ||
+			    (frame_.block_checksum && !read_exactly(word))) {
+				mark_damaged();
+				return false;
+			}
+			if (frame_.block_checksum) next.checksum = read32(word);
+			blocks.push_back(next);
+		}
+
+		auto const needed = blocks.size() * frame_.block_max;
+		if (batch_.size() < needed) batch_.resize(needed);
+
+		auto const check = policy() != verify::trusted;
+		auto const block_checks = check && frame_.block_checksum;
+		impl::parallel_for(blocks.size(), [&](size_t index) {
+			auto& current = blocks[index];
+			auto const src = packed_.data() + current.offset;
+			auto const dst = batch_.data() + index * frame_.block_max;
+
+			if (block_checks && arch::lz4::xxh32::hash({src, current.size}) !=
+			                        current.checksum) {
+				current.failed = true;
+				return;
+			}
+
+			if (current.stored) {
+				std::memcpy(dst, src, current.size);
+				current.decoded = current.size;
+				return;
+			}
+
+			auto const ret = LZ4_decompress_safe(
+			    reinterpret_cast<char const*>(src), reinterpret_cast<char*>(dst),
+			    static_cast<int>(current.size),
+			    static_cast<int>(frame_.block_max));
+			if (ret < 0)
+				current.failed = true;
+			else
+				current.decoded = static_cast<size_t>(ret);
+		});
+
+		batch_pos_ = 0;
+		batch_size_ = 0;
+		for (size_t index = 0; index < blocks.size(); ++index) {
+			auto const& current = blocks[index];
+			if (current.failed) {
+				mark_damaged();
+				mode_ = mode::done;
+				return batch_size_ != 0;
+			}
+
+			auto const src = batch_.data() + index * frame_.block_max;
+			if (src != batch_.data() + batch_size_)
+				std::memmove(batch_.data() + batch_size_, src, current.decoded);
+			batch_size_ += current.decoded;
+		}
+
+		if (check && frame_.content_checksum)
+			content_hash_.update({batch_.data(), batch_size_});
+
+		if (frame_end) {
+			mode_ = mode::frame;
+			if (frame_.content_checksum) {
+				if (!read_exactly(word)) {
+					mark_damaged();
+					mode_ = mode::done;
+					return batch_size_ != 0;
+				}
+				if (check) {
+					if (content_hash_.digest() != read32(word)) {
+						mark_damaged();
+						mode_ = mode::done;
+					} else
+						mark_checked();
+				}
+			}
+		}
+
+		return true;
+	}
+
+	bool lz4::skip_lowlevel(size_t length) {
+		std::byte buffer[10240];
+		while (length) {
+			auto const chunk = std::min(sizeof(buffer), length);
+			if (!read_exactly({buffer, chunk})) return false;
+			length -= chunk;
+		}
+		return true;
+	}
+}  // namespace arch::io
@@ -13,11 +13,16 @@ namespace arch::io {
 		return check_signature<0xFD, '7', 'z', 'X', 'Z', 0x00>(file);
 	}
 
-	io::seekable::ptr lzma::wrap(io::seekable::ptr&& file) {
-		return wrap_impl<lzma>(std::move(file), wrapper_tag{});
+	bool lzma::is_valid(std::span<std::byte const> prefix) {
+		return check_signature<0xFD, '7', 'z', 'X', 'Z', 0x00>(prefix);
+	}
+
+	io::seekable::ptr lzma::wrap(io::seekable::ptr&& file,
+	                             open_options const& opts) {
+		return wrap_impl<lzma>(std::move(file), opts, wrapper_tag{});
 	}
 
 	base::decompressor::ptr lzma::make_decompressor() {
-		return std::make_unique<arch::lzma::decompressor>();
+		return std::make_unique<arch::lzma::decompressor>(policy());
 	}
 }  // namespace arch::io
@@ -0,0 +1,292 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#define ZSTD_STATIC_LINKING_ONLY
+#include <arch/io/zstd.hh>
+#include <arch/zstd.hh>
+#include <algorithm>
+#include <cstring>
+#include "parallel.hh"
+
+namespace arch::io {
+	namespace {
+		inline uint32_t read32(std::byte const* data) noexcept {
+			return static_cast<uint32_t>(data[0]) |
+			       (static_cast<uint32_t>(data[1]) << 8) |
+			       (static_cast<uint32_t>(data[2]) << 16) |
+			       (static_cast<uint32_t>(data[3]) << 24);
+		}
+
+		constexpr uint32_t seek_table_magic = 0x184D2A5E;
+		constexpr uint32_t seekable_magic = 0x8F92EAB1;
+		constexpr size_t skippable_header = 8;
+		constexpr size_t seek_table_footer = 9;
+
+		// upper bound of the decoded data kept between reads; seek tables
+		// with larger frames are not used
+		constexpr size_t max_batch = 64 * 1024 * 1024;
+
+		struct frame_context {
+			ZSTD_DCtx* ctx{ZSTD_createDCtx()};
+			~frame_context() { ZSTD_freeDCtx(ctx); }
+		};
+
+		bool decode_frame(std::span<std::byte const> input,
+		                  std::span<std::byte> output,
+		                  verify policy) {
+			thread_local frame_context local{};
+			if (!local.ctx) return false;
+
+#ifdef ZSTD_d_forceIgnoreChecksum
+			ZSTD_DCtx_setParameter(local.ctx, ZSTD_d_forceIgnoreChecksum,
+			                       policy == verify::trusted
+			                           ? ZSTD_d_ignoreChecksum
+			                           : ZSTD_d_validateChecksum);
+#else
+			(void)policy;
+#endif
+
+			auto const ret =
+			    ZSTD_decompressDCtx(local.ctx, output.data(), output.size(),
+			                        input.data(), input.size());
+			return !ZSTD_isError(ret) && ret == output.size();
+		}
+	}  // namespace
+
+	zstd::zstd(wrapper_tag, std::vector<frame>&& frames)
+	    : frames_{std::move(frames)} {
+		if (!frames_.empty())
+			decoded_size_ =
+			    frames_.back().decoded_offset + frames_.back().decoded_size;
+	}
+
+	bool zstd::is_valid(io::seekable* file) {
+		std::byte magic[4];
+		if (file->seek(0) != 0 || file->read(magic) != sizeof(magic))
+			return false;
+		return is_valid(magic);
+	}
+
+	bool zstd::is_valid(std::span<std::byte const> prefix) {
+		// either a zstd frame, or a skippable frame (0x184D2A50-0x184D2A5F),
+		// which can precede the actual data
+		if (prefix.size() < 4) return false;
+
+		static constexpr unsigned char zstd_magic[] = {0x28, 0xB5, 0x2F,
+		                                               0xFD};
+		if (!std::memcmp(prefix.data(), zstd_magic, sizeof(zstd_magic)))
+			return true;
+		return (std::to_integer<unsigned>(prefix[0]) & 0xF0) == 0x50 &&
+		       prefix[1] == std::byte{0x2A} && prefix[2] == std::byte{0x4D} &&
+		       prefix[3] == std::byte{0x18};
+	}
+
+	io::seekable::ptr zstd::wrap(io::seekable::ptr&& file,
+	                             open_options const& opts) {
+		if (!file) return {};
+		auto frames = read_seek_table(file.get());
+		return wrap_impl<zstd>(std::move(file), opts, wrapper_tag{},
+		                       std::move(frames));
+	}
+
+	std::vector<zstd::frame> zstd::read_seek_table(io::seekable* file) {
+		std::vector<frame> result{};
+
+		auto const file_size = file->seek_end();
+		if (file_size < skippable_header + seek_table_footer) {
+			file->seek(0);
+			return result;
+		}
+
+		std::byte footer[seek_table_footer];
+		if (file->seek(file_size - sizeof(footer)) !=
+		        file_size - sizeof(footer) ||
+		    file->read(footer) != sizeof(footer) ||
+		    read32(footer + 5) != seekable_magic ||
+		    (static_cast<unsigned>(footer[4]) & 0x7C)) {
+			file->seek(0);
+			return result;
+		}
+
+		size_t const count = read32(footer);
+		auto const with_checksums = (static_cast<unsigned>(footer[4]) & 0x80);
+		size_t const entry_size = with_checksums ? 12 : 8;
+		// the count is not trusted until the table it describes fits in
+		// the file
+		if (count > (file_size - skippable_header - seek_table_footer) /
+		                entry_size) {
+			file->seek(0);
+			return result;
+		}
+		auto const table_size = count * entry_size + seek_table_footer;
+
+		std::vector<std::byte> table(skippable_header + table_size);
+
+		auto const table_offset = file_size - table.size();
+		if (file->seek(table_offset) != table_offset ||
+		    file->read(table) != table.size() ||
+		    read32(table.data()) != seek_table_magic ||
+		    read32(table.data() + 4) != table_size) {
+			file->seek(0);
+			return result;
+		}
+
+		result.reserve(count);
+		size_t offset{}, decoded_offset{};
+		auto entry = table.data() + skippable_header;
+		for (size_t index = 0; index < count; ++index, entry += entry_size) {
+			frame next{offset, decoded_offset, read32(entry),
+			           read32(entry + 4)};
+			if (next.decoded_size > max_batch) {
+				result.clear();
+				break;
+			}
+			offset += next.size;
+			decoded_offset += next.decoded_size;
+			result.push_back(next);
+		}
+
+		// the frames must cover everything before the table
+		if (offset != table_offset) result.clear();
+
+		file->seek(0);
+		return result;
+	}
+
+	std::size_t zstd::read(std::span<std::byte> buffer) {
+		if (frames_.empty()) return decoding_file::read(buffer);
+		if (buffer.empty() || eof()) return 0;
+
+		size_t result{};
+		while (result < buffer.size()) {
+			if (batch_pos_ < batch_size_) {
+				auto const chunk =
+				    std::min(batch_size_ - batch_pos_, buffer.size() - result);
+				std::memcpy(buffer.data() + result, batch_.data() + batch_pos_,
+				            chunk);
+				batch_pos_ += chunk;
+				result += chunk;
+				move_by(chunk);
+				continue;
+			}
+
+			if (!next_batch()) break;
+		}
+
+		if (result) return result;
+
+		eof_reached();
+		return 0;
+	}
+
+	std::size_t zstd::seek(std::size_t pos) {
+		if (frames_.empty()) return decoding_file::seek(pos);
+
+		if (pos > decoded_size_) pos = decoded_size_;
+		if (pos == tell()) return pos;
+
+		if (pos >= batch_start_ && pos - batch_start_ < batch_size_) {
+			batch_pos_ = pos - batch_start_;
+		} else if (pos == decoded_size_) {
+			next_frame_ = frames_.size();
+			batch_pos_ = 0;
+			batch_size_ = 0;
+		} else {
+			auto it = std::upper_bound(
+			    frames_.begin(), frames_.end(), pos,
+			    [](size_t pos, frame const& entry) {
+				    return pos < entry.decoded_offset;
+			    });
+			next_frame_ = static_cast<size_t>(
+			    std::distance(frames_.begin(), it) - 1);
+			skip_ = pos - frames_[next_frame_].decoded_offset;
+			batch_start_ = frames_[next_frame_].decoded_offset;
+			batch_pos_ = 0;
+			batch_size_ = 0;
+		}
+
+		reposition(pos);
+		return pos;
+	}
+
+	std::size_t zstd::seek_end() {
+		if (frames_.empty()) return decoding_file::seek_end();
+		return seek(decoded_size_);
+	}
+
+	base::decompressor::ptr zstd::make_decompressor() {
+		return std::make_unique<arch::zstd::decompressor>(policy());
+	}
+
+	void zstd::rewind() {
+		next_frame_ = 0;
+		skip_ = 0;
+		batch_pos_ = 0;
+		batch_size_ = 0;
+		batch_start_ = 0;
+		decoding_file::rewind();
+	}
+
+	bool zstd::next_batch() {
+		if (next_frame_ >= frames_.size()) return false;
+
+		// Frames are independent by definition, so a batch of them is read
+		// in one go and decoded at the same time, each straight into its
+		// place in the batch buffer.
+		auto const first = next_frame_;
+		auto const max_frames = impl::concurrency() * 2;
+		auto const& start = frames_[first];
+
+		auto last = first + 1;
+		while (last < frames_.size() && last - first < max_frames &&
+		       frames_[last].decoded_offset + frames_[last].decoded_size -
+		               start.decoded_offset <=
+		           max_batch)
+			++last;
+
+		auto const& stop = frames_[last - 1];
+		auto const packed_size = stop.offset + stop.size - start.offset;
+		auto const decoded_size =
+		    stop.decoded_offset + stop.decoded_size - start.decoded_offset;
+
+		packed_.resize(packed_size);
+		if (batch_.size() < decoded_size) batch_.resize(decoded_size);
+
+		auto file = raw_file();
+		if (file->seek(start.offset) != start.offset ||
+		    file->read(packed_) != packed_.size()) {
+			mark_damaged();
+			next_frame_ = frames_.size();
+			return false;
+		}
+
+		std::vector<char> failed(last - first);
+		impl::parallel_for(last - first, [&](size_t index) {
+			auto const& current = frames_[first + index];
+			auto const input = std::span{packed_}.subspan(
+			    current.offset - start.offset, current.size);
+			auto const output = std::span{batch_}.subspan(
+			    current.decoded_offset - start.decoded_offset,
+			    current.decoded_size);
+			failed[index] = !decode_frame(input, output, policy());
+		});
+
+		batch_start_ = start.decoded_offset;
+		batch_pos_ = skip_;
+		batch_size_ = decoded_size;
+		next_frame_ = last;
+		skip_ = 0;
+
+		auto const broken = std::find(failed.begin(), failed.end(), 1);
+		if (broken != failed.end()) {
+			auto const index =
+			    first + static_cast<size_t>(std::distance(failed.begin(), broken));
+			batch_size_ = frames_[index].decoded_offset - start.decoded_offset;
+			next_frame_ = frames_.size();
+			mark_damaged();
+		} else if (policy() != verify::trusted)
+			mark_checked();
+
+		return batch_pos_ < batch_size_ || next_frame_ < frames_.size();
+	}
+}  // namespace arch::io
@@ -0,0 +1,210 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include "arch/lz4.hh"
+#include <lz4.h>
+#include <algorithm>
+#include <cstring>
+#include "decompress_impl.hh"
+
+namespace arch::impl {
+	template <>
+	struct stream_traits<lz4::stream> : stream_traits_base<lz4::stream> {
+		static inline size_t decompress(lz4::stream* stream) noexcept {
+			LZ4F_decompressOptions_t options{};
+#if LZ4_VERSION_NUMBER >= 10904
+			options.skipChecksums = stream->skip_checksums ? 1 : 0;
+#endif
+
+			auto src_size = stream->avail_in;
+			auto dst_size = stream->avail_out;
+			auto const ret =
+			    LZ4F_decompress(stream->ctx, stream->next_out, &dst_size,
+			                    stream->next_in, &src_size, &options);
+
+			stream->next_in += src_size;
+			stream->avail_in -= src_size;
+			stream->next_out += dst_size;
+			stream->avail_out -= dst_size;
+			stream->pending = LZ4F_isError(ret) ? 0 : ret;
+			return ret;
+		}
+
+		// a block decoded into the context's own buffer is flushed on the
+		// following calls, whether there is more input or not
+		static inline bool pending(lz4::stream const& stream) noexcept {
+			return stream.pending != 0;
+		}
+
+		// the whole frame, with its content checksum, was decoded
+		static inline bool stream_end(size_t ret) noexcept { return !ret; }
+
+		static inline bool ok(size_t ret) noexcept {
+			return !LZ4F_isError(ret);
+		}
+	};
+}  // namespace arch::impl
+
+namespace arch::lz4 {
+	namespace {
+		inline uint32_t read32(std::byte const* data) noexcept {
+			return static_cast<uint32_t>(data[0]) |
+			       (static_cast<uint32_t>(data[1]) << 8) |
+			       (static_cast<uint32_t>(data[2]) << 16) |
+			       (static_cast<uint32_t>(data[3]) << 24);
+		}
+
+		inline uint64_t read64(std::byte const* data) noexcept {
+			return static_cast<uint64_t>(read32(data)) |
+			       (static_cast<uint64_t>(read32(data + 4)) << 32);
+		}
+
+		constexpr uint32_t prime1 = 0x9E3779B1U;
+		constexpr uint32_t prime2 = 0x85EBCA77U;
+		constexpr uint32_t prime3 = 0xC2B2AE3DU;
+		constexpr uint32_t prime4 = 0x27D4EB2FU;
+		constexpr uint32_t prime5 = 0x165667B1U;
+
+		inline uint32_t rotl(uint32_t value, int bits) noexcept {
+			return (value << bits) | (value >> (32 - bits));
+		}
+
+		inline uint32_t xxh_round(uint32_t acc, uint32_t input) noexcept {
+			return rotl(acc + input * prime2, 13) * prime1;
+		}
+
+		inline std::byte const* stripes(uint32_t (&acc)[4],
+		                                std::byte const* data,
+		                                std::byte const* end) noexcept {
+			while (end - data >= 16) {
+				acc[0] = xxh_round(acc[0], read32(data));
+				acc[1] = xxh_round(acc[1], read32(data + 4));
+				acc[2] = xxh_round(acc[2], read32(data + 8));
+				acc[3] = xxh_round(acc[3], read32(data + 12));
+				data += 16;
+			}
+			return data;
+		}
+	}  // namespace
+
+	std::optional<frame_header> read_frame_header(
+	    std::span<std::byte const> data) noexcept {
+		static constexpr size_t min_header = 7;
+		if (data.size() < min_header || read32(data.data()) != frame_magic)
+			return std::nullopt;
+
+		auto const flags = static_cast<unsigned>(data[4]);
+		auto const block = static_cast<unsigned>(data[5]);
+		auto const version = flags >> 6;
+		auto const block_id = (block >> 4) & 7;
+		if (version != 1 || (flags & 0x02) || (block & 0x8F) || block_id < 4)
+			return std::nullopt;
+
+		frame_header result{};
+		result.independent_blocks = (flags & 0x20) != 0;
+		result.block_checksum = (flags & 0x10) != 0;
+		result.content_checksum = (flags & 0x04) != 0;
+		result.dictionary = (flags & 0x01) != 0;
+		result.block_max = size_t{1} << (8 + 2 * block_id);
+
+		auto const has_size = (flags & 0x08) != 0;
+		result.size = min_header + (has_size ? 8 : 0) +
+		              (result.dictionary ? 4 : 0);
+		if (data.size() < result.size) return std::nullopt;
+
+		if (has_size) result.content_size = read64(data.data() + 6);
+
+		auto const descriptor = data.subspan(4, result.size - 5);
+		auto const checksum = (xxh32::hash(descriptor) >> 8) & 0xFF;
+		if (checksum != static_cast<uint32_t>(data[result.size - 1]))
+			return std::nullopt;
+
+		return result;
+	}
+
+	decompressor::decompressor(base::verify policy) {
+		if (LZ4F_isError(LZ4F_createDecompressionContext(&lzs_.ctx,
+		                                                 LZ4F_VERSION)))
+			lzs_.ctx = nullptr;
+		lzs_.skip_checksums = policy == base::verify::trusted;
+	}
+
+	decompressor::~decompressor() { LZ4F_freeDecompressionContext(lzs_.ctx); }
+
+	std::pair<size_t, size_t> decompressor::decompress(
+	    std::span<std::byte> input,
+	    std::span<std::byte> output) {
+		if (!lzs_.ctx) {
+			damaged_ = true;
+			return {};
+		}
+		return impl::decompress(input, output, lzs_, eof_, damaged_);
+	}
+
+	bool decompressor::reset() noexcept {
+		if (!lzs_.ctx) return false;
+		LZ4F_resetDecompressionContext(lzs_.ctx);
+		lzs_.pending = 0;
+		eof_ = false;
+		damaged_ = false;
+		return true;
+	}
+
+	void xxh32::reset(uint32_t seed) noexcept {
+		seed_ = seed;
+		acc_[0] = seed + prime1 + prime2;
+		acc_[1] = seed + prime2;
+		acc_[2] = seed;
+		acc_[3] = seed - prime1;
+		total_ = 0;
+		tail_size_ = 0;
+	}
+
+	void xxh32::update(std::span<std::byte const> data) noexcept {
+		total_ += data.size();
+
+		auto ptr = data.data();
+		auto const end = ptr + data.size();
+
+		if (tail_size_) {
+			auto const missing = std::min(sizeof(tail_) - tail_size_,
+			                              data.size());
+			std::memcpy(tail_ + tail_size_, ptr, missing);
+			tail_size_ += missing;
+			ptr += missing;
+			if (tail_size_ < sizeof(tail_)) return;
+			stripes(acc_, tail_, tail_ + sizeof(tail_));
+			tail_size_ = 0;
+		}
+
+		ptr = stripes(acc_, ptr, end);
+
+		tail_size_ = static_cast<size_t>(end - ptr);
+		if (tail_size_) std::memcpy(tail_, ptr, tail_size_);
+	}
+
+	uint32_t xxh32::digest() const noexcept {
+		uint32_t hash = total_ >= 16 ? rotl(acc_[0], 1) + rotl(acc_[1], 7) +
+		                                   rotl(acc_[2], 12) + rotl(acc_[3], 18)
+		                             : seed_ + prime5;
+		hash += static_cast<uint32_t>(total_);
+
+		auto ptr = tail_;
+		auto const end = tail_ + tail_size_;
+		while (end - ptr >= 4) {
+			hash = rotl(hash + read32(ptr) * prime3, 17) * prime4;
+			ptr += 4;
+		}
+		while (ptr < end) {
+			hash = rotl(hash + static_cast<uint32_t>(*ptr) * prime5, 11) * prime1;
+			++ptr;
+		}
+
+		hash ^= hash >> 15;
+		hash *= prime2;
+		hash ^= hash >> 13;
+		hash *= prime3;
+		hash ^= hash >> 16;
+		return hash;
+	}
+}  // namespace arch::lz4
@@ -3,6 +3,7 @@
 
 #include "arch/lzma.hh"
 #include <limits>
+#include "compress_impl.hh"
 #include "decompress_impl.hh"
 
 namespace arch::impl {
@@ -28,14 +29,37 @@ namespace arch::impl {
 		static inline constexpr bool stream_end(lzma_ret ret) noexcept {
 			return ret == LZMA_STREAM_END;
 		}
+
+		static inline constexpr bool recoverable(lzma_ret ret) noexcept {
+			return ret == LZMA_BUF_ERROR;
+		}
+	};
+
+	template <>
+	struct encoder_traits<lzma_stream> : stream_traits<lzma_stream> {
+		static inline lzma_ret encode(lzma_stream* stream,
+		                              base::flush_mode mode) noexcept {
+			// the threaded encoder can only flush by ending the block, the
+			// other one does not mind
+			static constexpr lzma_action action[] = {LZMA_RUN, LZMA_FULL_FLUSH,
+			                                         LZMA_FINISH};
+			return lzma_code(stream, action[static_cast<int>(mode)]);
+		}
 	};
 }  // namespace arch::impl
 
 namespace arch::lzma {
-	decompressor::decompressor() {
-		auto const lzret =
-		    lzma_auto_decoder(&lzs_, std::numeric_limits<uint64_t>::max(),
-		                      LZMA_TELL_ANY_CHECK | LZMA_TELL_NO_CHECK);
+	decompressor::decompressor(base::verify policy) {
+		uint32_t flags = LZMA_TELL_ANY_CHECK | LZMA_TELL_NO_CHECK;
+#ifdef LZMA_IGNORE_CHECK
+		// xz checks are computed inside liblzma, the only choice we have is
+		// whether they are computed at all
+		if (policy == base::verify::trusted) flags |= LZMA_IGNORE_CHECK;
+#else
+		(void)policy;
+#endif
+		auto const lzret = lzma_auto_decoder(
+		    &lzs_, std::numeric_limits<uint64_t>::max(), flags);
 		is_initialised_ = lzret == LZMA_OK;
 	}
 
@@ -46,6 +70,46 @@ namespace arch::lzma {
 	std::pair<size_t, size_t> decompressor::decompress(
 	    std::span<std::byte> input,
 	    std::span<std::byte> output) {
-		return impl::decompress(input, output, lzs_);
+		return impl::decompress(input, output, lzs_, eof_, damaged_);
+	}
+
+	compressor::compressor(uint32_t preset, lzma_check check) {
+		auto const lzret = lzma_easy_encoder(&lzs_, preset, check);
+		is_initialised_ = lzret == LZMA_OK;
+		failed_ = !is_initialised_;
+	}
+
+	compressor::compressor(threading const& mt,
+	                       uint32_t preset,
+	                       lzma_check check) {
+		lzma_mt options{};
+		options.threads = mt.threads ? mt.threads : lzma_cputhreads();
+		if (!options.threads) options.threads = 1;
+		options.block_size = mt.block_size;
+		options.preset = preset;
+		options.check = check;
+
+		if (mt.memlimit) {
+			// same as xz does, trade the threads for memory
+			while (options.threads > 1 &&
+			       lzma_stream_encoder_mt_memusage(&options) > mt.memlimit)
+				--options.threads;
+		}
+
+		auto const lzret = lzma_stream_encoder_mt(&lzs_, &options);
+		is_initialised_ = lzret == LZMA_OK;
+		failed_ = !is_initialised_;
+	}
+
+	compressor::~compressor() {
+		if (is_initialised_) lzma_end(&lzs_);
+	}
+
+	std::pair<size_t, size_t> compressor::compress(
+	    std::span<std::byte const> input,
+	    std::span<std::byte> output,
+	    base::flush_mode mode) {
+		if (failed_ || finished_) return {};
+		return impl::compress(input, output, lzs_, mode, finished_, failed_);
 	}
 }  // namespace arch::lzma
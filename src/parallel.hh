@@ -0,0 +1,27 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+namespace arch::impl {
+	// Number of tasks parallel_for() is able to run at the same time,
+	// including the calling thread.
+	std::size_t concurrency() noexcept;
+
+	// Calls task(0) ... task(count - 1) on the library's worker threads and
+	// the calling thread, returning after all of them are done. The task must
+	// not throw.
+	void parallel_for(std::size_t count,
+	                  std::function<void(std::size_t)> const& task);
+
+	// As parallel_for(), but also calls emit(0) ... emit(count - 1), in
+	// this order and one at a time, each as soon as its task and all the
+	// tasks before it are done, while the later ones are still running.
+	// Neither may throw.
+	void parallel_for_ordered(std::size_t count,
+	                          std::function<void(std::size_t)> const& task,
+	                          std::function<void(std::size_t)> const& emit);
+}  // namespace arch::impl
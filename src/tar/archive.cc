@@ -6,6 +6,7 @@
 #include <arch/tar/archive.hh>
 #include <arch/tar/entry.hh>
 #include "check_signature.hh"
+#include "format.hh"
 
 #include <sys/types.h>
 #include <algorithm>
@@ -21,108 +22,17 @@
 
 namespace arch::tar {
 	namespace {
-		constexpr size_t RECORDSIZE = 512;
-
-		constexpr auto REGTYPE = '0';           // regular file
-		constexpr auto AREGTYPE = '\0';         // regular file
-		constexpr auto LNKTYPE = '1';           // link (inside tarfile)
-		constexpr auto SYMTYPE = '2';           // symbolic link
-		constexpr auto CHRTYPE = '3';           // character special device
-		constexpr auto BLKTYPE = '4';           // block special device
-		constexpr auto DIRTYPE = '5';           // directory
-		constexpr auto FIFOTYPE = '6';          // fifo special device
-		constexpr auto CONTTYPE = '7';          // contiguous file
-		constexpr auto GNUTYPE_LONGNAME = 'L';  // GNU tar longname
-		constexpr auto GNUTYPE_LONGLINK = 'K';  // GNU tar longlink
-		constexpr auto GNUTYPE_SPARSE = 'S';    // GNU tar sparse file
-		constexpr auto POSIX_XHDTYPE = 'x';     // POSIX.1-2001 extended header
-
-		std::string_view as_string_view(std::string_view str) {
-			auto pos = str.find('\0');
-			if (pos == std::string_view::npos) return str;
-			return str.substr(0, pos);
-		}
-
 		std::string as_string(std::string_view str) {
 			auto trimmed = as_string_view(str);
 			return {trimmed.data(), trimmed.size()};
 		}
 
-		template <typename Value>
-		bool as_num(Value& result, std::string_view num) {
-			result = 0;
-			auto const unum0 = static_cast<unsigned char>(num[0]);
-			if (unum0 == 0200u || unum0 == 0377u) {
-				std::make_unsigned_t<Value> number{};
-				auto const is_neg = unum0 == 0377u;
-
-				for (auto signed_char : num.substr(1)) {
-					number <<= 8u;
-					number += static_cast<unsigned char>(signed_char);
-				}
-
-#ifdef _MSC_VER
-#pragma warning(push)
-// unary minus operator applied to unsigned type, result still unsigned
-#pragma warning(disable : 4146)
-#endif
-				// TODO: overflow...
-				if (is_neg)
-					result = static_cast<Value>(-number);
-				else
-					result = static_cast<Value>(number);
-#ifdef _MSC_VER
-#pragma warning(pop)
-#endif
-				return true;
-			}
-
-			num = as_string_view(num);
-			while (!num.empty() &&
-			       std::isspace(static_cast<unsigned char>(num.front())))
-				num = num.substr(1);
-
-			while (!num.empty() &&
-			       std::isspace(static_cast<unsigned char>(num.back())))
-				num = num.substr(0, num.size() - 1);
-
-			if (num.empty()) return {};
-
-			auto begin = num.data();
-			auto end = num.data() + num.size();
-
-			auto [ptr, ec] = std::from_chars(begin, end, result, 8);
-			return (ec == std::errc{} && ptr == end);
-		}
-
-		bool checksums(std::string_view header, int chksum) {
-			int unsigned_sum = 256;
-			int signed_sum = 256;
-
-			auto first = header.substr(0, 148);
-			auto second = header.substr(156);
-
-			for (auto const* chunk : {&first, &second}) {
-				signed_sum += std::accumulate(
-				    chunk->begin(), chunk->end(), 0,
-				    [](int ax, signed char c) { return ax + c; });
-				unsigned_sum += std::accumulate(
-				    chunk->begin(), chunk->end(), 0,
-				    [](int ax, unsigned char c) { return ax + c; });
-			}
-
-			return unsigned_sum == chksum || signed_sum == chksum;
-		}
-
-		inline size_t block_size(size_t size) noexcept {
-			return ((size + (RECORDSIZE - 1)) / RECORDSIZE) * RECORDSIZE;
-		}
-
 		fs::file_type fs_type(char type, bool& is_hardlink) {
 			switch (type) {
 				case REGTYPE:
 				case AREGTYPE:
 				case CONTTYPE:
+				case GNUTYPE_SPARSE:
 					return fs::file_type::regular;
 				case LNKTYPE:
 				case SYMTYPE:
@@ -147,6 +57,32 @@ namespace arch::tar {
 			static constexpr auto ALL = 07777u;
 			return static_cast<fs::perms>(mode & ALL);
 		}
+
+		size_t read_fully(io::stream& source, std::span<std::byte> buffer) {
+			size_t result{};
+			while (result < buffer.size()) {
+				auto const read = source.read(buffer.subspan(result));
+				if (!read) break;
+				result += read;
+			}
+			return result;
+		}
+
+		// old GNU sparse map: offset and size of each extent, in octal
+		// fields of 12 characters, up to the first empty slot
+		bool add_gnu_extents(std::vector<io::extent>& map,
+		                     std::string_view slots) {
+			static constexpr size_t slot_size = 24;
+			for (; slots.size() >= slot_size; slots = slots.substr(slot_size)) {
+				if (!slots[0]) break;
+				io::extent extent{};
+				if (!as_num(extent.offset, slots.substr(0, 12)) ||
+				    !as_num(extent.size, slots.substr(12, 12)))
+					return false;
+				map.push_back(extent);
+			}
+			return true;
+		}
 	}  // namespace
 
 #define HANDLE get_handle(handle_)
@@ -159,17 +95,39 @@ namespace arch::tar {
 		return header(entry, file);
 	}
 
-	bool archive::open(io::seekable::ptr file) {
+	bool archive::is_valid(std::span<std::byte const> prefix) {
+		if (check_signature<'u', 's', 't', 'a', 'r'>(prefix, 257)) return true;
+
+		Entry entry{};
+		return prefix.size() >= RECORDSIZE &&
+		       header(entry, prefix.first(RECORDSIZE));
+	}
+
+	bool archive::open(io::seekable::ptr file, open_options const& opts) {
 		file_ = std::move(file);
+		policy_ = opts.integrity;
 		if (!file_) return false;
 
-		std::byte byte[1];
-		auto const size = file_->read(std::span{byte});
+		// the first header tells apart the archives of the same size and
+		// time, when looking for a catalog; no more than what open() in
+		// archive.cc replays, so a decoded source is not rewound
+		std::byte head[RECORDSIZE];
+		auto const size = read_fully(
+		    *file_, opts.catalog_dir.empty() ? std::span{head}.first(1)
+		                                     : std::span{head});
 		file_->seek(0);
+		offset_ = file_->tell();
+		at_end_ = !size;
+		if (!size) return false;
+
+		if (!opts.catalog_dir.empty()) {
+			catalog_ =
+			    catalog_path(opts.catalog_dir, std::span{head}.first(size));
+			if (!catalog_.empty() && load_catalog())
+				return entries_.count() > 0;
+		}
 
-		if (size) load_entries();
-
-		return size == 1 && !entries_.empty();
+		return load_until(1);
 	}
 
 	void archive::close() {
@@ -177,35 +135,48 @@ namespace arch::tar {
 	}
 
 	size_t archive::count() const {
-		return entries_.size();
+		std::lock_guard lock{mutex_};
+		load_until(npos);
+		return entries_.count();
 	}
 
 	base::entry::ptr archive::entry(size_t index) const {
-		if (index >= entries_.size()) return {};
-		auto const& ref = entries_[index];
-
-		bool is_hardlink = false;
-		auto const type = fs_type(ref.type, is_hardlink);
-		io::status const file_status{ref.size,
-		                             base::io::to_file_clock(ref.mtime), type,
-		                             fs_perms(ref.mode), is_hardlink};
-		io::status const status = [&, self = this]() -> io::status {
-			auto const link =
-			    is_hardlink ? self->hardlink_for(index) : self->realpath(index);
-			if (link == index) return file_status;
-			if (link == self->entries_.size())
-				return {0, {}, fs::file_type::not_found, fs::perms::none};
-			auto const& linked = self->entries_[link];
-
-			bool link_is_also_hard = false;
-			auto const type = fs_type(linked.type, link_is_also_hard);
-			return {linked.size, base::io::to_file_clock(linked.mtime), type,
-			        fs_perms(linked.mode), link_is_also_hard};
-		}();
-
-		return std::make_unique<tar::entry>(ref.name, ref.linkname, file_.get(),
-		                                    ref.data_offset, file_status,
-		                                    status);
+		std::lock_guard lock{mutex_};
+		if (index == npos || !load_until(index + 1)) return {};
+		return make_entry(index);
+	}
+
+	base::entry::ptr archive::find(std::string_view name) const {
+		std::lock_guard lock{mutex_};
+		auto const index = index_of(std::string{name});
+		return index == npos ? nullptr : make_entry(index);
+	}
+
+	base::entry::ptr archive::make_entry(size_t index) const {
+		auto const status_of = [this](size_t index) {
+			bool is_hardlink = false;
+			auto const type = fs_type(entries_.types[index], is_hardlink);
+			return io::status{entries_.sizes[index],
+			                  base::io::to_file_clock(entries_.mtimes[index]),
+			                  type, fs_perms(entries_.modes[index]),
+			                  is_hardlink};
+		};
+
+		auto const file_status = status_of(index);
+		auto const link = link_for(index);
+		auto const status =
+		    link == index ? file_status
+		    : link == dangling
+		        ? io::status{0, {}, fs::file_type::not_found, fs::perms::none}
+		        : status_of(link);
+
+		size_t const data_offset = entries_.data_offsets[index];
+		auto const sparse = entries_.sparse_maps.find(index);
+		return std::make_unique<tar::entry>(
+		    fs::path{entries_.name(index)}, fs::path{entries_.linkname(index)},
+		    file_.get(), data_offset, file_status, status,
+		    sparse == entries_.sparse_maps.end() ? std::vector<io::extent>{}
+		                                         : sparse->second);
 	}
 
 	std::string normlized(fs::path const& path) {
@@ -263,69 +234,138 @@ namespace arch::tar {
 #endif
 	}
 
-	template <typename EntryType>
-	size_t realpath_impl_next(size_t index,
-	                          std::vector<EntryType> const& entries) {
-		auto const& ref = entries[index];
-		if (ref.type != SYMTYPE) return index;
-
-		auto path = normlized(fs::path{ref.name}.parent_path() / ref.linkname);
-		auto it =
-		    std::find_if(entries.begin(), entries.end(),
-		                 [&](auto const& entry) { return entry.name == path; });
-		if (it == entries.end()) return index;
-		return static_cast<size_t>(std::distance(entries.begin(), it));
+	void archive::entry_table::push(Entry const& entry) {
+		arena.append(entry.name);
+		bounds.push_back(arena.size());
+		arena.append(entry.linkname);
+		bounds.push_back(arena.size());
+		sizes.push_back(entry.file_size());
+		data_offsets.push_back(entry.data_offset);
+		if (entry.sparse) sparse_maps.emplace(types.size(), entry.sparse_map);
+		mtimes.push_back(entry.mtime);
+		modes.push_back(entry.mode);
+		types.push_back(entry.type);
+	}
+
+	size_t archive::lookup(std::string_view name) const {
+		auto const [begin, end] =
+		    names_.equal_range(std::hash<std::string_view>{}(name));
+		for (auto it = begin; it != end; ++it) {
+			if (entries_.name(it->second) == name) return it->second;
+		}
+		return npos;
+	}
+
+	void archive::index_names() const {
+		// the first member of a given name wins
+		for (; named_ < entries_.count(); ++named_) {
+			auto const name = entries_.name(named_);
+			if (lookup(name) == npos)
+				names_.emplace(std::hash<std::string_view>{}(name), named_);
+		}
+	}
+
+	size_t archive::find_loaded(std::string_view name) const {
+		index_names();
+		return lookup(name);
 	}
 
-	template <typename EntryType>
-	size_t realpath_impl(size_t index,
-	                     std::vector<EntryType> const& entries,
-	                     std::unordered_set<size_t>& needles) {
-		auto const next = realpath_impl_next(index, entries);
-		if (next == index || needles.count(next)) return index;
-		needles.insert(index);
-		return realpath_impl(next, entries, needles);
+	size_t archive::index_of(std::string const& name) const {
+		// the first member of a given name wins; the ones still to be read
+		// can only come later
+		auto index = find_loaded(name);
+		while (index == npos && load_until(entries_.count() + 1)) {
+			auto const last = entries_.count() - 1;
+			if (entries_.name(last) == name) index = last;
+		}
+		return index;
+	}
+
+	size_t archive::next_hop(size_t index) const {
+		if (entries_.types[index] != SYMTYPE) return index;
+		auto const link =
+		    index_of(normlized(fs::path{entries_.name(index)}.parent_path() /
+		                   entries_.linkname(index)));
+		return link == npos ? index : link;
 	}
 
 	size_t archive::realpath(size_t index) const {
+		// the first hop back to an already visited link ends the chain
 		std::unordered_set<size_t> needles{};
-		auto result = realpath_impl(index, entries_, needles);
-		if (result < entries_.size() && entries_[result].type == SYMTYPE)
-			return entries_.size();
+		auto result = index;
+		while (true) {
+			auto const next = next_hop(result);
+			if (next == result || needles.count(next)) break;
+			needles.insert(result);
+			result = next;
+		}
+
+		if (entries_.types[result] == SYMTYPE) return dangling;
 		return result;
 	}
 
-	size_t archive::hardlink_for(size_t index) const {
-		auto const& ref = entries_[index];
+	size_t archive::link_for(size_t index) const {
+		if (links_[index] != unresolved) return links_[index];
 
-		if (ref.type != LNKTYPE) return index;
+		auto link = index;
+		switch (entries_.types[index]) {
+			case LNKTYPE:
+				link = index_of(std::string{entries_.linkname(index)});
+				if (link == npos) link = index;
+				break;
+			case SYMTYPE:
+				link = realpath(index);
+				break;
+			default:
+				break;
+		}
 
-		auto it = std::find_if(
-		    entries_.begin(), entries_.end(),
-		    [&](auto const& entry) { return entry.name == ref.linkname; });
-		if (it == entries_.end()) return index;
-		return static_cast<size_t>(std::distance(entries_.begin(), it));
+		links_[index] = link;
+		return link;
 	}
 
-	void archive::load_entries() {
-		offset_ = file_->tell();
+	bool archive::load_until(size_t count) const {
+		while (entries_.count() < count && !at_end_ && file_) {
+			auto const start = offset_;
+			Entry entry{};
+			if (!next(entry) || (entry.sparse && !finish_sparse(entry))) {
+				at_end_ = true;
+				// only the table ending on the end-of-archive marker is whole;
+				// a broken header or damaged data would be trusted from then on
+				if (!catalog_.empty() && marker_ == start &&
+				    file_->verification() != verify_result::damaged)
+					save_catalog();
+				break;
+			}
 
-		while (true) {
-			entries_.push_back({});
-			if (next(entries_.back())) continue;
-			entries_.pop_back();
-			break;
+			entries_.push(entry);
+			links_.push_back(unresolved);
 		}
+
+		return entries_.count() >= count;
 	}
 
-	bool archive::next(Entry& entry) {
+	bool archive::next(Entry& entry) const {
 		if (offset_ != file_->tell()) {
 			file_->seek(offset_ - 1);
 			std::byte ignores[1];
 			if (!file_->read(ignores)) return false;
 		}
 
-		if (!header(entry, file_.get())) return false;
+		std::byte record[RECORDSIZE];
+		auto const start = file_->tell();
+		if (file_->read(record) != RECORDSIZE) return false;
+		if (std::all_of(std::begin(record), std::end(record),
+		                [](std::byte b) { return b == std::byte{}; })) {
+			marker_ = start;
+			return false;
+		}
+
+		// the format was already recognized by is_valid(), trusted archives do
+		// not need to have the rest of the headers summed up
+		if (!header(entry, record, policy_ != verify::trusted) ||
+		    !read_gnu_sparse(entry, *file_))
+			return false;
 
 		entry.data_offset = file_->tell();
 		entry.offset = entry.data_offset - RECORDSIZE;
@@ -348,10 +388,7 @@ namespace arch::tar {
 				return apply_gnulong(entry);
 
 			case POSIX_XHDTYPE:
-				offset += block_size(entry.size);
-				entries_.pop_back();
-				// Do NOT use entry from now on...
-				break;
+				return apply_pax(entry);
 
 			// everything else, see how much data is attach to the entry.
 			default:
@@ -363,15 +400,22 @@ namespace arch::tar {
 		return true;
 	}
 
-	bool archive::header(Entry& entry, io::seekable* file) {
-		std::byte header[RECORDSIZE];
-		if (file->read(header) != RECORDSIZE) return false;
+	bool archive::header(Entry& entry,
+	                     io::seekable* file,
+	                     bool verify_checksum) {
+		std::byte record[RECORDSIZE];
+		if (file->read(record) != RECORDSIZE) return false;
+		return header(entry, record, verify_checksum);
+	}
 
-		std::string_view view{reinterpret_cast<char const*>(header),
+	bool archive::header(Entry& entry,
+	                     std::span<std::byte const> record,
+	                     bool verify_checksum) {
+		std::string_view view{reinterpret_cast<char const*>(record.data()),
 		                      RECORDSIZE};
 
 		if (!as_num(entry.chksum, view.substr(148, 8))) return false;
-		if (!checksums(view, entry.chksum)) return false;
+		if (verify_checksum && !checksums(view, entry.chksum)) return false;
 
 		entry.name = as_string(view.substr(0, 100));
 		if (!as_num(entry.mode, view.substr(100, 8))) return false;
@@ -379,7 +423,6 @@ namespace arch::tar {
 		if (!as_num(entry.mtime, view.substr(136, 12))) return false;
 		entry.type = view[156];
 		entry.linkname = as_string(view.substr(157, 100));
-		entry.magic.assign(view.substr(257, 6));
 
 		auto prefix = as_string(view.substr(345, 155));
 
@@ -403,10 +446,89 @@ namespace arch::tar {
 			}
 		}
 
+		if (entry.type == GNUTYPE_SPARSE) {
+			// four extents fit in the header, the rest follows it
+			entry.sparse = true;
+			entry.sparse_extended = view[GNU_ISEXTENDED] != 0;
+			if (!as_num(entry.realsize, view.substr(483, 12)) ||
+			    !add_gnu_extents(entry.sparse_map, view.substr(386, 96)))
+				return false;
+		}
+
+		return true;
+	}
+
+	bool archive::read_gnu_sparse(Entry& entry, io::stream& source) {
+		std::byte record[RECORDSIZE];
+		while (entry.sparse_extended) {
+			if (read_fully(source, record) != RECORDSIZE) return false;
+			std::string_view view{reinterpret_cast<char const*>(record),
+			                      RECORDSIZE};
+			if (!add_gnu_extents(entry.sparse_map,
+			                     view.substr(0, GNU_EXT_ISEXTENDED)))
+				return false;
+			entry.sparse_extended = view[GNU_EXT_ISEXTENDED] != 0;
+		}
+		return true;
+	}
+
+	bool archive::read_sparse_map(Entry& entry, io::stream& source) {
+		// decimal numbers, one a line: the count of the extents, then their
+		// offsets and sizes; the map takes whole records
+		std::string text{};
+		size_t pos{};
+		auto const next_number = [&](uintmax_t& number) {
+			auto newline = text.find('\n', pos);
+			while (newline == std::string::npos) {
+				std::byte record[RECORDSIZE];
+				if (text.size() + RECORDSIZE > entry.size ||
+				    read_fully(source, record) != RECORDSIZE)
+					return false;
+				text.append(reinterpret_cast<char const*>(record), RECORDSIZE);
+				newline = text.find('\n', pos);
+			}
+
+			auto const end = text.data() + newline;
+			auto const [ptr, ec] =
+			    std::from_chars(text.data() + pos, end, number);
+			pos = newline + 1;
+			return ec == std::errc{} && ptr == end;
+		};
+
+		uintmax_t count{};
+		if (!next_number(count) || count > entry.size) return false;
+		for (uintmax_t index = 0; index < count; ++index) {
+			io::extent extent{};
+			if (!next_number(extent.offset) || !next_number(extent.size))
+				return false;
+			entry.sparse_map.push_back(extent);
+		}
+
+		entry.size -= text.size();
+		entry.data_offset += text.size();
 		return true;
 	}
 
-	bool archive::apply_gnulong(Entry& entry) {
+	bool archive::finish_sparse(Entry& entry) {
+		uintmax_t end{};
+		uintmax_t stored{};
+		for (auto const& extent : entry.sparse_map) {
+			// checked before adding, so that no sum can wrap around
+			if (extent.offset < end || extent.offset > entry.realsize ||
+			    extent.size > entry.realsize - extent.offset)
+				return false;
+			end = extent.offset + extent.size;
+			stored += extent.size;
+		}
+		if (stored > entry.size) return false;
+
+		// the file might end with a hole
+		if (entry.sparse_map.empty() || end < entry.realsize)
+			entry.sparse_map.push_back({entry.realsize, 0});
+		return true;
+	}
+
+	bool archive::apply_gnulong(Entry& entry) const {
 		std::vector<std::byte> longname(block_size(entry.size));
 		if (file_->read({longname.data(), longname.size()}) !=
 		    longname.size()) {
@@ -429,4 +551,361 @@ namespace arch::tar {
 
 		return true;
 	}
+
+	bool archive::apply_pax(Entry& entry) const {
+		auto const records_size = entry.size;
+		std::vector<std::byte> records(block_size(records_size));
+		if (file_->read({records.data(), records.size()}) != records.size()) {
+			return false;
+		}
+
+		offset_ = file_->tell();
+
+		auto const current_offset = entry.offset;
+		if (!next(entry)) return false;
+		entry.offset = current_offset;
+
+		auto const header_size = entry.size;
+		apply_pax_records(entry,
+		                  {reinterpret_cast<char const*>(records.data()),
+		                   records_size});
+
+		// the header's own size decided, where the next one starts
+		if (entry.size != header_size &&
+		    offset_ == entry.data_offset + block_size(header_size))
+			offset_ = entry.data_offset + block_size(entry.size);
+
+		// the data starts right after the header just read
+		if (entry.sparse && entry.sparse_map_in_data &&
+		    !read_sparse_map(entry, *file_))
+			return false;
+
+		return true;
+	}
+
+	void archive::apply_pax_records(Entry& entry, std::string_view view) {
+		// GNU sparse members keep the real name apart from the path
+		std::string_view sparse_name{};
+
+		for_each_pax_record(view, [&](std::string_view key,
+		                              std::string_view value) {
+			if (key == "path") {
+				entry.name.assign(value);
+				if (entry.type == DIRTYPE) {
+					while (entry.name.ends_with('/'))
+						entry.name.pop_back();
+				}
+			} else if (key == "linkpath") {
+				entry.linkname.assign(value);
+			} else if (key == "size") {
+				size_t size{};
+				if (as_decimal(size, value)) entry.size = size;
+			} else if (key == "mtime") {
+				// fractions of seconds are not kept
+				auto const end = value.data() + value.size();
+				std::from_chars(value.data(), end, entry.mtime);
+			} else if (key == "GNU.sparse.size" ||
+			           key == "GNU.sparse.realsize") {
+				entry.sparse = as_decimal(entry.realsize, value);
+			} else if (key == "GNU.sparse.name") {
+				sparse_name = value;
+			} else if (key == "GNU.sparse.major") {
+				// 1.0 keeps the map with the data, 0.x in these records
+				entry.sparse_map_in_data = value == "1";
+			} else if (key == "GNU.sparse.offset") {
+				// 0.0: each offset is followed by its numbytes
+				io::extent extent{};
+				if (as_decimal(extent.offset, value))
+					entry.sparse_map.push_back(extent);
+			} else if (key == "GNU.sparse.numbytes") {
+				if (!entry.sparse_map.empty())
+					as_decimal(entry.sparse_map.back().size, value);
+			} else if (key == "GNU.sparse.map") {
+				// 0.1: "<offset>,<size>,<offset>,<size>..."
+				entry.sparse_map.clear();
+				auto map = value;
+				while (!map.empty()) {
+					auto const offset = map.substr(0, map.find(','));
+					map = map.substr(std::min(map.size(), offset.size() + 1));
+					auto const size = map.substr(0, map.find(','));
+					map = map.substr(std::min(map.size(), size.size() + 1));
+
+					io::extent extent{};
+					if (!as_decimal(extent.offset, offset) ||
+					    !as_decimal(extent.size, size))
+						break;
+					entry.sparse_map.push_back(extent);
+				}
+			}
+		});
+
+		if (!sparse_name.empty()) entry.name.assign(sparse_name);
+	}
+
+	namespace {
+		bool skip(io::stream& source, size_t length) {
+			std::byte buffer[32 * RECORDSIZE];
+			while (length) {
+				auto const chunk = std::min(length, sizeof(buffer));
+				if (read_fully(source, {buffer, chunk}) != chunk) return false;
+				length -= chunk;
+			}
+			return true;
+		}
+
+		// Data of the current member, straight from the source
+		class member_stream final : public io::stream_mixin {
+		public:
+			member_stream(io::stream& source,
+			              size_t size,
+			              io::status const& file_status,
+			              io::status const& status,
+			              fs::path const& link,
+			              std::span<io::extent const> sparse_map)
+			    : io::stream_mixin{file_status, status, link}
+			    , source_{source}
+			    , rest_{size}
+			    , sparse_map_{sparse_map} {}
+
+			void close() final {}
+
+			std::size_t read(std::span<std::byte> bytes) final {
+				if (!sparse_map_.empty()) return read_sparse(bytes, true);
+
+				if (bytes.size() > rest_) bytes = bytes.subspan(0, rest_);
+				auto const read = source_.read(bytes);
+				rest_ -= read;
+				return read;
+			}
+
+			verify_result verification() final {
+				return source_.verification();
+			}
+
+			std::span<io::extent const> sparse_map() const final {
+				return sparse_map_;
+			}
+
+			std::size_t skip(std::size_t length) final {
+				if (sparse_map_.empty()) return io::stream::skip(length);
+
+				// only the data needs to be read from the source
+				std::byte buffer[32 * RECORDSIZE];
+				size_t result{};
+				while (result < length) {
+					auto const chunk =
+					    std::min(length - result, sizeof(buffer));
+					auto const read = read_sparse({buffer, chunk}, false);
+					if (!read) break;
+					result += read;
+				}
+				return result;
+			}
+
+			size_t rest() const noexcept { return rest_; }
+
+		private:
+			// holes are filled with zeros, only if they are to be seen
+			std::size_t read_sparse(std::span<std::byte> bytes, bool fill) {
+				auto const size = file_status().size;
+				size_t result{};
+				while (!bytes.empty() && pos_ < size) {
+					auto const run =
+					    find_run(sparse_map_, index_, stored_, pos_, size);
+					size_t const chunk =
+					    std::min<uintmax_t>(bytes.size(), run.length);
+					auto const part = bytes.first(chunk);
+
+					auto read = chunk;
+					if (run.is_data) {
+						// the data is stored in the order of the map
+						read = source_.read(part);
+						rest_ -= read;
+					} else if (fill) {
+						std::fill(part.begin(), part.end(), std::byte{});
+					}
+
+					pos_ += read;
+					result += read;
+					bytes = bytes.subspan(read);
+					if (read < chunk) break;
+				}
+				return result;
+			}
+
+			io::stream& source_;
+			size_t rest_;
+			std::span<io::extent const> sparse_map_;
+			uintmax_t pos_{};
+			size_t index_{};
+			uintmax_t stored_{};
+		};
+
+		// Hands out the member_stream it was created with
+		class borrowed_stream final : public io::stream_mixin {
+		public:
+			explicit borrowed_stream(io::stream& contents)
+			    : io::stream_mixin{contents.file_status(),
+			                       contents.linked_status(),
+			                       contents.linkname()}
+			    , contents_{contents} {}
+
+			void close() final {}
+			std::size_t read(std::span<std::byte> bytes) final {
+				return contents_.read(bytes);
+			}
+			verify_result verification() final {
+				return contents_.verification();
+			}
+			std::span<io::extent const> sparse_map() const final {
+				return contents_.sparse_map();
+			}
+			std::size_t skip(std::size_t length) final {
+				return contents_.skip(length);
+			}
+
+		private:
+			io::stream& contents_;
+		};
+
+		class streamed_entry final : public base::entry_mixin {
+		public:
+			streamed_entry(fs::path const& filename, member_stream& contents)
+			    : base::entry_mixin{contents.file_status(),
+			                        contents.linked_status(),
+			                        contents.linkname()}
+			    , filename_{filename}
+			    , contents_{contents} {}
+
+			fs::path const& filename() const final { return filename_; }
+			io::stream::ptr file() const final {
+				return std::make_unique<borrowed_stream>(contents_);
+			}
+
+		private:
+			fs::path filename_;
+			member_stream& contents_;
+		};
+	}  // namespace
+
+	bool archive::for_each_entry(io::stream& source,
+	                             visitor const& visit,
+	                             open_options const& opts) {
+		auto const verify_checksum = opts.integrity != verify::trusted;
+		static io::status const not_found{0, {}, fs::file_type::not_found,
+		                                  fs::perms::none};
+
+		// hard links take the status of their target, symlinks the one the
+		// target resolves to
+		struct member_status {
+			io::status own{};
+			io::status resolved{};
+		};
+		std::unordered_map<std::string, member_status> seen{};
+		// from the GNU long name/link and pax members before the next header
+		std::string longname{}, longlink{};
+		std::vector<std::byte> pax{};
+		size_t pax_size{};
+
+		std::byte record[RECORDSIZE];
+		while (true) {
+			auto const read = read_fully(source, record);
+			// missing end-of-archive marker is tolerated, as in open()
+			if (!read) return true;
+			if (read != RECORDSIZE) return false;
+			if (std::all_of(std::begin(record), std::end(record),
+			                [](std::byte b) { return b == std::byte{}; }))
+				return true;
+
+			Entry entry{};
+			if (!header(entry, record, verify_checksum) ||
+			    !read_gnu_sparse(entry, source))
+				return false;
+
+			switch (entry.type) {
+				case GNUTYPE_LONGNAME:
+				case GNUTYPE_LONGLINK:
+				case POSIX_XHDTYPE: {
+					std::vector<std::byte> data(block_size(entry.size));
+					if (read_fully(source, data) != data.size()) return false;
+					if (entry.type == POSIX_XHDTYPE) {
+						pax = std::move(data);
+						pax_size = entry.size;
+						continue;
+					}
+
+					std::string_view view{
+					    reinterpret_cast<char const*>(data.data()),
+					    data.size()};
+					(entry.type == GNUTYPE_LONGNAME ? longname : longlink) =
+					    as_string(view);
+					continue;
+				}
+				default:
+					break;
+			}
+
+			if (!longname.empty()) entry.name = std::move(longname);
+			if (!longlink.empty()) entry.linkname = std::move(longlink);
+			if (!pax.empty()) {
+				apply_pax_records(
+				    entry,
+				    {reinterpret_cast<char const*>(pax.data()), pax_size});
+			}
+			longname.clear();
+			longlink.clear();
+			pax.clear();
+
+			if (entry.sparse && entry.sparse_map_in_data &&
+			    !read_sparse_map(entry, source))
+				return false;
+			if (entry.sparse && !finish_sparse(entry)) return false;
+
+			size_t data_size{};
+			switch (entry.type) {
+				case LNKTYPE:
+				case SYMTYPE:
+				case DIRTYPE:
+				case FIFOTYPE:
+				case CONTTYPE:
+				case CHRTYPE:
+				case BLKTYPE:
+					break;
+				default:
+					data_size = entry.size;
+					break;
+			}
+
+			bool is_hardlink = false;
+			auto const type = fs_type(entry.type, is_hardlink);
+			io::status const file_status{
+			    entry.file_size(), base::io::to_file_clock(entry.mtime), type,
+			    fs_perms(entry.mode), is_hardlink};
+
+			auto status = file_status;
+			if (entry.type == LNKTYPE || entry.type == SYMTYPE) {
+				auto const target =
+				    is_hardlink ? entry.linkname
+				                : normlized(fs::path{entry.name}.parent_path() /
+				                            entry.linkname);
+				auto const it = seen.find(target);
+				if (is_hardlink)
+					status = it != seen.end() ? it->second.own : file_status;
+				else
+					status = it != seen.end() ? it->second.resolved : not_found;
+			}
+			// the first member of a given name wins, as in index_of()
+			seen.try_emplace(entry.name, member_status{file_status, status});
+
+			member_stream contents{source,         data_size,
+			                       file_status,    status,
+			                       entry.linkname, entry.sparse_map};
+			streamed_entry current{entry.name, contents};
+			if (!visit(current, contents)) return true;
+
+			if (!skip(source, contents.rest() +
+			                      (block_size(data_size) - data_size)))
+				return false;
+		}
+	}
 }  // namespace arch::tar
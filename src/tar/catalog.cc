@@ -0,0 +1,227 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include <arch/io/file.hh>
+#include <arch/tar/archive.hh>
+#include <arch/zlib.hh>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace arch::tar {
+	namespace {
+		constexpr char catalog_magic[8] = {'a', 'r', 'c', 'h', 't',
+		                                   'a', 'r', 'c'};
+		constexpr uint32_t catalog_version = 1;
+		// catalogs are only read back on the same kind of machine: with the
+		// same byte order and the same sizes of time_t and size_t
+		constexpr auto catalog_layout = static_cast<uint32_t>(
+		    0x01000000u | sizeof(time_t) << 8u | sizeof(size_t));
+
+		// Followed by the arena, the columns of the table, the links and
+		// the sparse maps, each as it is kept in memory
+		struct catalog_header {
+			char magic[8]{};
+			uint32_t version{};
+			uint32_t layout{};
+			uint64_t size{};
+			int64_t mtime{};
+			uint32_t fingerprint{};
+			uint32_t reserved{};
+			uint64_t count{};
+			uint64_t arena_size{};
+			// members with a sparse map and the extents of all of them
+			uint64_t sparse_count{};
+			uint64_t extent_count{};
+		};
+
+		template <typename Value>
+		bool read_column(io::file& file,
+		                 std::vector<Value>& column,
+		                 size_t count) {
+			column.resize(count);
+			auto const bytes = std::as_writable_bytes(std::span{column});
+			return file.read(bytes) == bytes.size();
+		}
+
+		template <typename Value>
+		bool write_column(io::file& file, std::vector<Value> const& column) {
+			auto const bytes = std::as_bytes(std::span{column});
+			return file.write(bytes) == bytes.size();
+		}
+	}  // namespace
+
+	fs::path archive::catalog_path(fs::path const& dir,
+	                               std::span<std::byte const> head) {
+		// without a file of its own, the source has nothing to be known by
+		auto const& status = file_->linked_status();
+		if (status.type != fs::file_type::regular) return {};
+
+		key_.size = status.size;
+		key_.mtime = status.last_write_time.time_since_epoch().count();
+		key_.fingerprint =
+		    static_cast<uint32_t>(zlib::crc32_update(0, head) & 0xFFFFFFFFu);
+
+		char name[64];
+		std::snprintf(name, sizeof(name), "%016llx-%016llx-%08x.catalog",
+		              static_cast<unsigned long long>(key_.size),
+		              static_cast<unsigned long long>(key_.mtime),
+		              unsigned{key_.fingerprint});
+		return dir / name;
+	}
+
+	bool archive::load_catalog() {
+		std::error_code ec{};
+		auto const file_size = fs::file_size(catalog_, ec);
+		if (ec) return false;
+
+		auto file = io::file::open(catalog_);
+		if (!file) return false;
+
+		catalog_header header{};
+		if (file->read(std::as_writable_bytes(std::span{&header, 1})) !=
+		        sizeof(header) ||
+		    std::memcmp(header.magic, catalog_magic, sizeof(catalog_magic)) ||
+		    header.version != catalog_version ||
+		    header.layout != catalog_layout || header.size != key_.size ||
+		    header.mtime != key_.mtime ||
+		    header.fingerprint != key_.fingerprint)
+			return false;
+
+		// anything bigger than the file itself is damaged; checked before
+		// it is allocated
+		if (header.count > file_size || header.arena_size > file_size ||
+		    header.sparse_count > file_size || header.extent_count > file_size)
+			return false;
+
+		size_t const count = header.count;
+		size_t const sparse_count = header.sparse_count;
+		size_t const extent_count = header.extent_count;
+		auto const expected =
+		    sizeof(header) + header.arena_size +
+		    (2 * count + 1) * sizeof(uint64_t) +
+		    count * (2 * sizeof(uint64_t) + sizeof(time_t) +
+		             sizeof(unsigned) + sizeof(char) + sizeof(size_t)) +
+		    sparse_count * 2 * sizeof(uint64_t) +
+		    extent_count * sizeof(io::extent);
+		if (expected != file_size) return false;
+
+		entry_table entries{};
+		std::vector<size_t> links{};
+		std::vector<uint64_t> sparse_indices{};
+		std::vector<uint64_t> sparse_sizes{};
+		std::vector<io::extent> extents{};
+
+		entries.arena.resize(header.arena_size);
+		if (file->read(std::as_writable_bytes(std::span{entries.arena})) !=
+		        entries.arena.size() ||
+		    !read_column(*file, entries.bounds, 2 * count + 1) ||
+		    !read_column(*file, entries.sizes, count) ||
+		    !read_column(*file, entries.data_offsets, count) ||
+		    !read_column(*file, entries.mtimes, count) ||
+		    !read_column(*file, entries.modes, count) ||
+		    !read_column(*file, entries.types, count) ||
+		    !read_column(*file, links, count) ||
+		    !read_column(*file, sparse_indices, sparse_count) ||
+		    !read_column(*file, sparse_sizes, sparse_count) ||
+		    !read_column(*file, extents, extent_count))
+			return false;
+
+		// the views into the arena and the links must stay inside
+		for (size_t slot = 0; slot < 2 * count; ++slot) {
+			if (entries.bounds[slot] > entries.bounds[slot + 1]) return false;
+		}
+		if (entries.bounds.front() != 0 ||
+		    entries.bounds.back() != entries.arena.size())
+			return false;
+		for (auto const link : links) {
+			if (link >= count && link != dangling) return false;
+		}
+
+		size_t first_extent{};
+		for (size_t index = 0; index < sparse_count; ++index) {
+			size_t const member = sparse_indices[index];
+			size_t const size = sparse_sizes[index];
+			if (member >= count || size > extent_count - first_extent)
+				return false;
+			auto const begin =
+			    extents.begin() + static_cast<ptrdiff_t>(first_extent);
+			entries.sparse_maps[member].assign(
+			    begin, begin + static_cast<ptrdiff_t>(size));
+			first_extent += size;
+		}
+
+		entries_ = std::move(entries);
+		links_ = std::move(links);
+		names_.clear();
+		named_ = 0;
+
+		at_end_ = true;
+		return true;
+	}
+
+	void archive::save_catalog() const {
+		// the links are kept resolved, all of them are in the table by now
+		auto const count = entries_.count();
+		for (size_t index = 0; index < count; ++index)
+			link_for(index);
+
+		std::vector<uint64_t> sparse_indices{};
+		std::vector<uint64_t> sparse_sizes{};
+		std::vector<io::extent> extents{};
+		for (size_t index = 0; index < count; ++index) {
+			auto const it = entries_.sparse_maps.find(index);
+			if (it == entries_.sparse_maps.end()) continue;
+			sparse_indices.push_back(index);
+			sparse_sizes.push_back(it->second.size());
+			extents.insert(extents.end(), it->second.begin(),
+			               it->second.end());
+		}
+
+		catalog_header header{};
+		std::memcpy(header.magic, catalog_magic, sizeof(catalog_magic));
+		header.version = catalog_version;
+		header.layout = catalog_layout;
+		header.size = key_.size;
+		header.mtime = key_.mtime;
+		header.fingerprint = key_.fingerprint;
+		header.count = count;
+		header.arena_size = entries_.arena.size();
+		header.sparse_count = sparse_indices.size();
+		header.extent_count = extents.size();
+
+		// written aside and moved in place, so that no one reads it half
+		// done
+		auto temp = catalog_;
+		temp += ".";
+		temp += std::to_string(
+		    std::chrono::steady_clock::now().time_since_epoch().count());
+
+		std::error_code ec{};
+		fs::create_directories(catalog_.parent_path(), ec);
+
+		auto file = io::file::open(temp, "wb");
+		if (!file) return;
+
+		auto const written =
+		    file->write(std::as_bytes(std::span{&header, 1})) ==
+		        sizeof(header) &&
+		    file->write(std::as_bytes(std::span{entries_.arena})) ==
+		        entries_.arena.size() &&
+		    write_column(*file, entries_.bounds) &&
+		    write_column(*file, entries_.sizes) &&
+		    write_column(*file, entries_.data_offsets) &&
+		    write_column(*file, entries_.mtimes) &&
+		    write_column(*file, entries_.modes) &&
+		    write_column(*file, entries_.types) &&
+		    write_column(*file, links_) &&
+		    write_column(*file, sparse_indices) &&
+		    write_column(*file, sparse_sizes) &&
+		    write_column(*file, extents);
+		file->close();
+
+		if (written) fs::rename(temp, catalog_, ec);
+		if (!written || ec) fs::remove(temp, ec);
+	}
+}  // namespace arch::tar
@@ -10,16 +10,19 @@ namespace arch::tar {
 	             io::seekable* proxied,
 	             size_t offset,
 	             io::status const& file_status,
-	             io::status const& status)
+	             io::status const& status,
+	             std::vector<io::extent> sparse_map)
 	    : base::entry_mixin{file_status, status, link}
 	    , filename_{filename}
 	    , proxied_{proxied}
-	    , offset_{offset} {}
+	    , offset_{offset}
+	    , sparse_map_{std::move(sparse_map)} {}
 
 	fs::path const& entry::filename() const { return filename_; }
 
 	io::stream::ptr entry::file() const {
 		return std::make_unique<stream>(proxied_, offset_, file_status(),
-		                                linked_status(), linkname());
+		                                linked_status(), linkname(),
+		                                sparse_map_);
 	}
 }  // namespace arch::tar
@@ -0,0 +1,254 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#pragma once
+
+#include <arch/base/io/stream.hh>
+#include <charconv>
+#include <cstddef>
+#include <limits>
+#include <span>
+#include <string_view>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LIBARCH_TAR_SSE2
+#include <emmintrin.h>
+#elif (defined(__ARM_NEON) && defined(__aarch64__)) || defined(_M_ARM64)
+#define LIBARCH_TAR_NEON
+#include <arm_neon.h>
+#endif
+
+namespace arch::tar {
+	constexpr size_t RECORDSIZE = 512;
+
+	constexpr auto REGTYPE = '0';           // regular file
+	constexpr auto AREGTYPE = '\0';         // regular file
+	constexpr auto LNKTYPE = '1';           // link (inside tarfile)
+	constexpr auto SYMTYPE = '2';           // symbolic link
+	constexpr auto CHRTYPE = '3';           // character special device
+	constexpr auto BLKTYPE = '4';           // block special device
+	constexpr auto DIRTYPE = '5';           // directory
+	constexpr auto FIFOTYPE = '6';          // fifo special device
+	constexpr auto CONTTYPE = '7';          // contiguous file
+	constexpr auto GNUTYPE_LONGNAME = 'L';  // GNU tar longname
+	constexpr auto GNUTYPE_LONGLINK = 'K';  // GNU tar longlink
+	constexpr auto GNUTYPE_SPARSE = 'S';    // GNU tar sparse file
+	constexpr auto POSIX_XHDTYPE = 'x';     // POSIX.1-2001 extended header
+
+	// old GNU sparse members: the flag telling more of the map follows, in
+	// the header and in each of the extension records after it; the
+	// records come before the data
+	constexpr size_t GNU_ISEXTENDED = 482;
+	constexpr size_t GNU_EXT_ISEXTENDED = 504;
+
+	inline size_t block_size(size_t size) noexcept {
+		return ((size + (RECORDSIZE - 1)) / RECORDSIZE) * RECORDSIZE;
+	}
+
+	inline std::string_view as_string_view(std::string_view str) {
+		auto pos = str.find('\0');
+		if (pos == std::string_view::npos) return str;
+		return str.substr(0, pos);
+	}
+
+	template <typename Value>
+	bool as_num(Value& result, std::string_view num) {
+		result = 0;
+		auto const unum0 = static_cast<unsigned char>(num[0]);
+		if (unum0 == 0200u || unum0 == 0377u) {
+			std::make_unsigned_t<Value> number{};
+			auto const is_neg = unum0 == 0377u;
+
+			for (auto signed_char : num.substr(1)) {
+				number <<= 8u;
+				number += static_cast<unsigned char>(signed_char);
+			}
+
+#ifdef _MSC_VER
+#pragma warning(push)
+// unary minus operator applied to unsigned type, result still unsigned
+#pragma warning(disable : 4146)
+#endif
+			// TODO: overflow...
+			if (is_neg)
+				result = static_cast<Value>(-number);
+			else
+				result = static_cast<Value>(number);
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+			return true;
+		}
+
+		// Octal digits, with spaces around them, up to the first NUL. One
+		// pass over the field, as this runs several times for each header.
+		using unsigned_value = std::make_unsigned_t<Value>;
+		static constexpr auto max_value =
+		    static_cast<unsigned_value>(std::numeric_limits<Value>::max());
+
+		auto const is_space = [](char c) {
+			return c == ' ' || (c >= '\t' && c <= '\r');
+		};
+
+		auto it = num.begin();
+		auto const end = num.end();
+		while (it != end && is_space(*it))
+			++it;
+
+		bool is_neg = false;
+		if constexpr (std::is_signed_v<Value>) {
+			is_neg = it != end && *it == '-';
+			if (is_neg) ++it;
+		}
+
+		// 64 bits hold 21 digits, more than any of the header fields has
+		uint64_t number{};
+		auto const digits = it;
+		for (; it != end; ++it) {
+			auto const digit = static_cast<unsigned char>(*it - '0');
+			if (digit > 7u) break;
+			if (number >> 61u) return false;
+			number = (number << 3u) | digit;
+		}
+		if (it == digits) return false;
+
+		while (it != end && is_space(*it))
+			++it;
+		if (it != end && *it != '\0') return false;
+
+		if (number > uint64_t{max_value} + (is_neg ? 1u : 0u)) return false;
+		auto const value = static_cast<unsigned_value>(number);
+		result = is_neg ? static_cast<Value>(0u - value)
+		                : static_cast<Value>(value);
+		return true;
+	}
+
+	// decimal numbers of the pax records, with nothing else around them
+	template <typename Value>
+	bool as_decimal(Value& result, std::string_view value) {
+		auto const end = value.data() + value.size();
+		auto const parsed = std::from_chars(value.data(), end, result);
+		return parsed.ec == std::errc{} && parsed.ptr == end;
+	}
+
+	// Calls visit(key, value) for each "<length> <key>=<value>\n" record of
+	// a pax extended header, up to the first broken one
+	template <typename Visit>
+	void for_each_pax_record(std::string_view view, Visit&& visit) {
+		while (!view.empty()) {
+			auto const space = view.find(' ');
+			if (space == std::string_view::npos) break;
+
+			// the length covers the whole record
+			size_t length{};
+			auto [ptr, ec] =
+			    std::from_chars(view.data(), view.data() + space, length);
+			if (ec != std::errc{} || length < space + 2 || length > view.size())
+				break;
+
+			auto const record = view.substr(space + 1, length - space - 2);
+			view = view.substr(length);
+
+			auto const equals = record.find('=');
+			if (equals == std::string_view::npos) continue;
+			visit(record.substr(0, equals), record.substr(equals + 1));
+		}
+	}
+
+	// The bytes taken as unsigned and the count of the ones with the high
+	// bit set; each of those makes the signed sum smaller by 256, so both
+	// sums come out of one pass.
+	struct byte_sums {
+		unsigned total{};
+		unsigned high{};
+	};
+
+	inline byte_sums sum_bytes(unsigned char const* data, size_t size) {
+		byte_sums result{};
+		size_t index{};
+
+#if defined(LIBARCH_TAR_SSE2)
+		auto const zero = _mm_setzero_si128();
+		auto const one = _mm_set1_epi8(1);
+		auto total = zero;
+		auto high = zero;
+		for (; index + 16 <= size; index += 16) {
+			auto const chunk = _mm_loadu_si128(
+			    reinterpret_cast<__m128i const*>(data + index));
+			auto const is_high =
+			    _mm_and_si128(_mm_cmplt_epi8(chunk, zero), one);
+			total = _mm_add_epi64(total, _mm_sad_epu8(chunk, zero));
+			high = _mm_add_epi64(high, _mm_sad_epu8(is_high, zero));
+		}
+		total = _mm_add_epi64(total, _mm_srli_si128(total, 8));
+		high = _mm_add_epi64(high, _mm_srli_si128(high, 8));
+		result.total = static_cast<unsigned>(_mm_cvtsi128_si32(total));
+		result.high = static_cast<unsigned>(_mm_cvtsi128_si32(high));
+#elif defined(LIBARCH_TAR_NEON)
+		auto total = vdupq_n_u32(0);
+		auto high = vdupq_n_u32(0);
+		for (; index + 16 <= size; index += 16) {
+			auto const chunk = vld1q_u8(data + index);
+			total = vpadalq_u16(total, vpaddlq_u8(chunk));
+			high = vpadalq_u16(high, vpaddlq_u8(vshrq_n_u8(chunk, 7)));
+		}
+		result.total = vaddvq_u32(total);
+		result.high = vaddvq_u32(high);
+#endif
+
+		for (; index < size; ++index) {
+			result.total += data[index];
+			result.high += data[index] >> 7u;
+		}
+		return result;
+	}
+
+	inline bool checksums(std::string_view header, int chksum) {
+		static constexpr size_t field_offset = 148;
+		static constexpr size_t field_size = 8;
+		if (header.size() < field_offset + field_size) return false;
+
+		// the checksum field itself is summed up as eight spaces
+		auto const data = reinterpret_cast<unsigned char const*>(header.data());
+		auto const all = sum_bytes(data, header.size());
+		auto const field = sum_bytes(data + field_offset, field_size);
+
+		auto const unsigned_sum =
+		    static_cast<int>(all.total - field.total) + 256;
+		auto const signed_sum =
+		    unsigned_sum - 256 * static_cast<int>(all.high - field.high);
+
+		return unsigned_sum == chksum || signed_sum == chksum;
+	}
+
+	struct sparse_run {
+		bool is_data{};
+		// bytes until the next data or hole starts
+		uintmax_t length{};
+		// where the position is kept in the stored data
+		uintmax_t stored{};
+	};
+
+	// Finds the data or the hole at pos; index and stored keep the extent
+	// reached so far and the size of the data before it, for the streams,
+	// which only ever read forward
+	inline sparse_run find_run(std::span<io::extent const> map,
+	                           size_t& index,
+	                           uintmax_t& stored,
+	                           uintmax_t pos,
+	                           uintmax_t size) {
+		while (index < map.size() &&
+		       map[index].offset + map[index].size <= pos) {
+			stored += map[index].size;
+			++index;
+		}
+
+		if (index == map.size()) return {false, size - pos, stored};
+		auto const& current = map[index];
+		if (current.offset > pos) return {false, current.offset - pos, stored};
+		return {true, current.offset + current.size - pos,
+		        stored + (pos - current.offset)};
+	}
+}  // namespace arch::tar
@@ -0,0 +1,410 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#define NOMINMAX
+
+#include <arch/tar/join.hh>
+#include <arch/zlib.hh>
+#include "format.hh"
+
+#include <algorithm>
+#include <limits>
+
+namespace arch::tar {
+	namespace {
+		constexpr size_t window_size = 32 * 1024;
+		constexpr size_t chunk_size = 64 * 1024;
+		constexpr size_t npos = std::numeric_limits<size_t>::max();
+		constexpr std::byte end_of_archive_marker[RECORDSIZE * 2]{};
+
+		struct gzip_inflater {
+			gzip_inflater() {
+#if defined(__GNUC__) && (__GNUC__ >= 7)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#endif
+
+				is_initialised = inflateInit2(&z, MAX_WBITS + 16) == Z_OK;
+
+#if defined(__GNUC__) && (__GNUC__ >= 7)
+#pragma GCC diagnostic pop
+#endif
+			}
+
+			~gzip_inflater() {
+				if (is_initialised) inflateEnd(&z);
+			}
+
+			bool is_initialised{false};
+			z_stream z{};
+		};
+
+		bool is_zero(std::span<std::byte const> record) {
+			return std::all_of(record.begin(), record.end(),
+			                   [](std::byte b) { return b == std::byte{}; });
+		}
+
+		// size the ustar field gives the data following the header, npos
+		// for broken headers; extended, if old GNU sparse records come
+		// between the two
+		size_t member_size(std::span<std::byte const> record, bool& extended) {
+			std::string_view const view{
+			    reinterpret_cast<char const*>(record.data()), record.size()};
+
+			int chksum{};
+			size_t size{};
+			if (!as_num(chksum, view.substr(148, 8)) ||
+			    !checksums(view, chksum) || !as_num(size, view.substr(124, 12)))
+				return npos;
+			extended = view[156] == GNUTYPE_SPARSE && view[GNU_ISEXTENDED];
+			return size;
+		}
+
+		// the size from a pax extended header, for the member it comes
+		// before; npos, if there is none
+		size_t pax_size(std::span<std::byte const> records) {
+			size_t result{npos};
+			for_each_pax_record(
+			    {reinterpret_cast<char const*>(records.data()), records.size()},
+			    [&](std::string_view key, std::string_view value) {
+				    size_t size{};
+				    if (key == "size" && as_decimal(size, value)) result = size;
+			    });
+			return result;
+		}
+
+		// the second byte might still be in the source
+		bool is_gzip(z_stream const& z) {
+			return z.avail_in && z.next_in[0] == 0x1f &&
+			       (z.avail_in < 2 || z.next_in[1] == 0x8b);
+		}
+	}  // namespace
+
+	gzip_joiner::gzip_joiner(io::writeable::ptr output, int level)
+	    : output_{std::move(output)}
+	    , level_{std::clamp(level, 0, 9)}
+	    , buffer_(chunk_size) {
+		static constexpr int default_mem_level = 8;
+		static constexpr std::byte header[] = {
+		    std::byte{0x1f}, std::byte{0x8b}, std::byte{Z_DEFLATED},
+		    std::byte{0},    std::byte{0},    std::byte{0},
+		    std::byte{0},    std::byte{0},    std::byte{0},
+		    std::byte{3},
+		};
+
+#if defined(__GNUC__) && (__GNUC__ >= 7)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#endif
+
+		is_initialised_ =
+		    deflateInit2(&z_, level_, Z_DEFLATED, -MAX_WBITS,
+		                 default_mem_level, Z_DEFAULT_STRATEGY) == Z_OK;
+
+#if defined(__GNUC__) && (__GNUC__ >= 7)
+#pragma GCC diagnostic pop
+#endif
+
+		crc_ = ::crc32(0, nullptr, 0);
+		failed_ = !output_ || !is_initialised_;
+		put(header);
+	}
+
+	gzip_joiner::~gzip_joiner() {
+		finish();
+		if (is_initialised_) deflateEnd(&z_);
+	}
+
+	bool gzip_joiner::append(io::stream& source) {
+		if (failed_ || !output_) return false;
+
+		gzip_inflater inflater{};
+		if (!inflater.is_initialised) {
+			failed_ = true;
+			return false;
+		}
+		auto& z = inflater.z;
+
+		std::vector<std::byte> input(chunk_size);
+		bool source_eof{false};
+		// compressed bytes of the current gzip member, from raw_base on
+		std::vector<std::byte> raw{};
+		size_t raw_base{};
+		auto const read_more = [&] {
+			if (z.avail_in || source_eof) return;
+			auto const read = source.read(input);
+			if (!read) {
+				source_eof = true;
+				return;
+			}
+			z.next_in = reinterpret_cast<Bytef*>(input.data());
+			z.avail_in = static_cast<uInt>(read);
+			raw.insert(raw.end(), input.begin(),
+			           input.begin() + static_cast<ptrdiff_t>(read));
+		};
+		// decoded bytes, from data_base on
+		std::vector<std::byte> data{};
+		size_t data_base{};
+
+		// last block boundary: in bits of the member and in decoded bytes
+		size_t boundary_bits{npos};
+		size_t boundary{};
+		size_t decoded{};
+		size_t next_header{};
+		// old GNU sparse extension records still to come, before the data
+		bool extended{false};
+		size_t data_size{};
+		// from the pax header in front of the next member, npos if none
+		size_t next_size{npos};
+		size_t end_of_archive{npos};
+		// decoded bytes added to the CRC
+		size_t checked{};
+
+		auto const update_crc = [&](size_t limit) {
+			if (limit <= checked) return;
+			crc_ = zlib::crc32_update(
+			    crc_, std::span{data}.subspan(checked - data_base,
+			                                  limit - checked));
+			checked = limit;
+		};
+
+		// blocks up to the new boundary are copied, except for the bits of
+		// the last byte, which might still be needed by deflatePrime()
+		auto const copy_to = [&](size_t bits) {
+			auto const to = bits / 8;
+			auto const from = boundary_bits == npos ? to : boundary_bits / 8;
+			if (to > from && !put({raw.data() + (from - raw_base), to - from}))
+				return false;
+
+			raw.erase(raw.begin(),
+			          raw.begin() + static_cast<ptrdiff_t>(to - raw_base));
+			raw_base = to;
+			boundary_bits = bits;
+			boundary = decoded;
+
+			auto const keep = std::max(
+			    data_base,
+			    std::min(boundary - std::min(boundary, window_size), checked));
+			data.erase(data.begin(),
+			           data.begin() + static_cast<ptrdiff_t>(keep - data_base));
+			data_base = keep;
+			return true;
+		};
+
+		// everything between the boundary and the end is deflated again
+		auto const close_segment = [&](size_t end) {
+			if (boundary_bits == npos) return false;
+
+			prime_bits_ = static_cast<int>(boundary_bits % 8);
+			prime_value_ = 0;
+			if (prime_bits_) {
+				auto const last = raw[boundary_bits / 8 - raw_base];
+				prime_value_ =
+				    std::to_integer<int>(last) & ((1 << prime_bits_) - 1);
+			}
+
+			auto const window = std::max(
+			    data_base, boundary - std::min(boundary, window_size));
+			auto const decoded_data = std::span{data};
+			return encode(
+			    decoded_data.subspan(window - data_base, boundary - window),
+			    decoded_data.subspan(boundary - data_base, end - boundary),
+			    false);
+		};
+
+		while (true) {
+			read_more();
+
+			auto const before = data.size();
+			data.resize(before + chunk_size);
+			z.next_out = reinterpret_cast<Bytef*>(data.data() + before);
+			z.avail_out = static_cast<uInt>(chunk_size);
+			auto const ret = ::inflate(&z, Z_BLOCK);
+			auto const produced = chunk_size - z.avail_out;
+			data.resize(before + produced);
+			decoded += produced;
+
+			// Z_BUF_ERROR without any input left: the source is truncated
+			if ((ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) ||
+			    (ret == Z_BUF_ERROR && source_eof)) {
+				failed_ = true;
+				return false;
+			}
+
+			while (end_of_archive == npos &&
+			       decoded >= next_header + RECORDSIZE) {
+				auto const record = std::span{data}.subspan(
+				    next_header - data_base, RECORDSIZE);
+				if (extended) {
+					extended = record[GNU_EXT_ISEXTENDED] != std::byte{};
+					next_header += RECORDSIZE + (extended ? 0 : data_size);
+					continue;
+				}
+
+				if (is_zero(record)) {
+					end_of_archive = next_header;
+					break;
+				}
+
+				auto size = member_size(record, extended);
+				if (size == npos) {
+					failed_ = true;
+					return false;
+				}
+
+				auto const type = static_cast<char>(record[156]);
+				if (type == POSIX_XHDTYPE) {
+					// the records are needed in full, before going on
+					if (decoded < next_header + RECORDSIZE + size) break;
+					next_size = pax_size(std::span{data}.subspan(
+					    next_header + RECORDSIZE - data_base, size));
+				} else if (type != GNUTYPE_LONGNAME &&
+				           type != GNUTYPE_LONGLINK && next_size != npos) {
+					// large members keep their real size only in the pax
+					// header, as the reader takes it
+					size = next_size;
+					next_size = npos;
+				}
+				data_size = block_size(size);
+				next_header += RECORDSIZE + (extended ? 0 : data_size);
+			}
+			update_crc(end_of_archive != npos ? end_of_archive
+			                                  : std::min(next_header, decoded));
+
+			auto const at_boundary = ret == Z_OK && (z.data_type & 128) &&
+			                         !(z.data_type & 64);
+			// a boundary inside a header, which is not decoded in full yet,
+			// might be past the marker
+			if (at_boundary && decoded <= next_header) {
+				size_t const total_in = z.total_in;
+				auto const bits =
+				    total_in * 8 - static_cast<size_t>(z.data_type & 7);
+				if (!copy_to(bits)) return false;
+			}
+
+			if (end_of_archive != npos && decoded >= end_of_archive &&
+			    (decoded > end_of_archive || at_boundary))
+				break;
+
+			if (ret != Z_STREAM_END) continue;
+
+			read_more();
+			if (end_of_archive == npos && !is_gzip(z)) {
+				// no marker at the end of the source
+				end_of_archive = decoded;
+				update_crc(end_of_archive);
+			}
+
+			if (end_of_archive != npos) break;
+
+			// next gzip member; the bytes after the previous one are the
+			// start of the new raw buffer
+			if (!close_segment(decoded) || inflateReset(&z) != Z_OK) {
+				failed_ = true;
+				return false;
+			}
+			auto const next = reinterpret_cast<std::byte const*>(z.next_in);
+			raw.assign(next, next + z.avail_in);
+			raw_base = 0;
+			boundary_bits = npos;
+			boundary = decoded;
+		}
+
+		if (!close_segment(end_of_archive)) {
+			failed_ = true;
+			return false;
+		}
+
+		size_ += end_of_archive;
+		return true;
+	}
+
+	bool gzip_joiner::finish() {
+		if (!output_) return !failed_;
+
+		auto result = !failed_;
+		if (result) {
+			crc_ = zlib::crc32_update(crc_, end_of_archive_marker);
+			size_ += sizeof(end_of_archive_marker);
+
+			std::byte trailer[8]{};
+			for (size_t index = 0; index < 4; ++index) {
+				trailer[index] =
+				    static_cast<std::byte>((crc_ >> (8 * index)) & 0xFF);
+				trailer[index + 4] =
+				    static_cast<std::byte>((size_ >> (8 * index)) & 0xFF);
+			}
+
+			result = encode({}, end_of_archive_marker, true) && put(trailer);
+		}
+
+		output_->close();
+		output_.reset();
+		if (!result) failed_ = true;
+		return result;
+	}
+
+	bool gzip_joiner::encode(std::span<std::byte const> dictionary,
+	                         std::span<std::byte const> data,
+	                         bool last) {
+		if (failed_) return false;
+
+		auto const prime_bits = prime_bits_;
+		auto const prime_value = prime_value_;
+		prime_bits_ = 0;
+		prime_value_ = 0;
+
+		if (deflateReset(&z_) != Z_OK ||
+		    (!dictionary.empty() &&
+		     deflateSetDictionary(
+		         &z_, reinterpret_cast<Bytef const*>(dictionary.data()),
+		         static_cast<uInt>(dictionary.size())) != Z_OK) ||
+		    (prime_bits && deflatePrime(&z_, prime_bits, prime_value) != Z_OK)) {
+			failed_ = true;
+			return false;
+		}
+
+		static constexpr size_t max_chunk = 1u << 30;
+		while (true) {
+			auto const chunk = std::min(data.size(), max_chunk);
+			auto const is_last_chunk = chunk == data.size();
+			auto const flush = !is_last_chunk ? Z_NO_FLUSH
+			                   : last         ? Z_FINISH
+			                                  : Z_SYNC_FLUSH;
+
+			// deflate does not write to the input, it only misses the const
+			z_.next_in = reinterpret_cast<Bytef*>(
+			    const_cast<std::byte*>(data.data()));
+			z_.avail_in = static_cast<uInt>(chunk);
+
+			int ret{};
+			do {
+				z_.next_out = reinterpret_cast<Bytef*>(buffer_.data());
+				z_.avail_out = static_cast<uInt>(buffer_.size());
+				ret = ::deflate(&z_, flush);
+				if (ret == Z_STREAM_ERROR) {
+					failed_ = true;
+					return false;
+				}
+				if (!put({buffer_.data(), buffer_.size() - z_.avail_out}))
+					return false;
+			} while (!z_.avail_out || (flush == Z_FINISH && ret != Z_STREAM_END));
+
+			data = data.subspan(chunk);
+			if (is_last_chunk) break;
+		}
+
+		return true;
+	}
+
+	bool gzip_joiner::put(std::span<std::byte const> data) {
+		if (failed_ || !output_) return false;
+		if (data.empty()) return true;
+
+		if (output_->write(data) != data.size()) {
+			failed_ = true;
+			return false;
+		}
+		return true;
+	}
+}  // namespace arch::tar
@@ -2,16 +2,21 @@
 // This code is licensed under MIT license (see LICENSE for details)
 
 #include <arch/tar/stream.hh>
+#include "format.hh"
+
+#include <algorithm>
 
 namespace arch::tar {
 	stream::stream(io::seekable* proxied,
 	               size_t offset,
 	               io::status const& file_status,
 	               io::status const& status,
-	               fs::path const& link)
+	               fs::path const& link,
+	               std::vector<io::extent> sparse_map)
 	    : io::stream_mixin{file_status, status, link}
 	    , proxied_{proxied}
-	    , offset_{offset} {}
+	    , offset_{offset}
+	    , sparse_map_{std::move(sparse_map)} {}
 
 	stream::~stream() { close(); }
 
@@ -20,6 +25,8 @@ namespace arch::tar {
 	}
 
 	std::size_t stream::read(std::span<std::byte> bytes) {
+		if (!sparse_map_.empty()) return read_sparse(bytes);
+
 		auto const newpos = proxied_->seek(pos_ + offset_);
 		if (newpos != pos_ + offset_) return 0;
 
@@ -33,4 +40,47 @@ namespace arch::tar {
 		pos_ += read;
 		return read;
 	}
+
+	std::size_t stream::read_sparse(std::span<std::byte> bytes) {
+		auto const size = file_status().size;
+		size_t result{};
+		while (!bytes.empty() && pos_ < size) {
+			auto const run = find_run(sparse_map_, sparse_index_,
+			                          sparse_stored_, pos_, size);
+			size_t const chunk = std::min<uintmax_t>(bytes.size(), run.length);
+			auto const part = bytes.first(chunk);
+
+			auto read = chunk;
+			if (run.is_data) {
+				size_t const stored = offset_ + run.stored;
+				if (proxied_->seek(stored) != stored) break;
+				read = proxied_->read(part);
+			} else {
+				std::fill(part.begin(), part.end(), std::byte{});
+			}
+
+			pos_ += read;
+			result += read;
+			bytes = bytes.subspan(read);
+			if (read < chunk) break;
+		}
+		return result;
+	}
+
+	verify_result stream::verification() {
+		// tar has no checksums of its own, but the filter below might
+		return proxied_->verification();
+	}
+
+	std::span<io::extent const> stream::sparse_map() const {
+		return sparse_map_;
+	}
+
+	std::size_t stream::skip(std::size_t length) {
+		// each read seeks to its own position anyway
+		auto const rest = file_status().size - pos_;
+		if (length > rest) length = rest;
+		pos_ += length;
+		return length;
+	}
 }  // namespace arch::tar
@@ -0,0 +1,392 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#define NOMINMAX
+
+#include <arch/io/file.hh>
+#include <arch/tar/writer.hh>
+#include "format.hh"
+#include "fs_tree.hh"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace arch::tar {
+	namespace {
+		using record = std::array<char, RECORDSIZE>;
+
+		constexpr size_t name_size = 100;
+		constexpr size_t prefix_size = 155;
+		constexpr size_t size_size = 12;
+		constexpr std::byte zeros[RECORDSIZE * 2]{};
+
+		// octal, when the value fits, GNU's base-256 otherwise (both are
+		// understood by archive::header())
+		void put_number(char* field, size_t width, uintmax_t value) {
+			auto const max_octal = (uintmax_t{1} << (3 * (width - 1))) - 1;
+			if (value <= max_octal) {
+				field[width - 1] = '\0';
+				for (size_t index = width - 1; index-- > 0;) {
+					field[index] = static_cast<char>('0' + (value & 7));
+					value >>= 3;
+				}
+				return;
+			}
+
+			field[0] = static_cast<char>(0200);
+			for (size_t index = width; index-- > 1;) {
+				field[index] = static_cast<char>(value & 0xFF);
+				value >>= 8;
+			}
+		}
+
+		void put_string(char* field, size_t width, std::string_view value) {
+			std::memcpy(field, value.data(), std::min(width, value.size()));
+		}
+
+		// ustar keeps long names in two fields, split on one of the slashes
+		bool split_name(std::string_view name,
+		                std::string_view& prefix,
+		                std::string_view& rest) {
+			if (name.size() <= name_size) {
+				prefix = {};
+				rest = name;
+				return true;
+			}
+
+			auto pos = name.find('/');
+			while (pos != std::string_view::npos && pos <= prefix_size) {
+				if (pos && name.size() - pos - 1 <= name_size) {
+					prefix = name.substr(0, pos);
+					rest = name.substr(pos + 1);
+					return true;
+				}
+				pos = name.find('/', pos + 1);
+			}
+			return false;
+		}
+
+		size_t digits(size_t value) {
+			size_t result = 1;
+			while (value >= 10) {
+				value /= 10;
+				++result;
+			}
+			return result;
+		}
+
+		// "<length> <key>=<value>\n", length counting its own digits
+		void pax_record(std::string& out,
+		                std::string_view key,
+		                std::string_view value) {
+			auto const payload = key.size() + value.size() + 3;
+			auto length = payload + digits(payload);
+			if (digits(length) + payload != length)
+				length = payload + digits(length);
+
+			out += std::to_string(length);
+			out += ' ';
+			out += key;
+			out += '=';
+			out += value;
+			out += '\n';
+		}
+
+		char type_flag(member const& header) {
+			if (header.hardlink) return LNKTYPE;
+			switch (header.type) {
+				case fs::file_type::regular:
+					return REGTYPE;
+				case fs::file_type::directory:
+					return DIRTYPE;
+				case fs::file_type::symlink:
+					return SYMTYPE;
+				default:
+					break;
+			}
+			return 0;
+		}
+
+		void fill_header(record& block,
+		                 std::string_view prefix,
+		                 std::string_view name,
+		                 unsigned mode,
+		                 uintmax_t size,
+		                 time_t mtime,
+		                 char type,
+		                 std::string_view linkname) {
+			block.fill(0);
+			put_string(block.data(), name_size, name);
+			put_number(block.data() + 100, 8, mode);
+			put_number(block.data() + 108, 8, 0);
+			put_number(block.data() + 116, 8, 0);
+			put_number(block.data() + 124, size_size, size);
+			put_number(block.data() + 136, 12,
+			           static_cast<uintmax_t>(std::max(time_t{}, mtime)));
+			block[156] = type;
+			put_string(block.data() + 157, name_size, linkname);
+			put_string(block.data() + 257, 6, "ustar");
+			put_string(block.data() + 263, 2, "00");
+			put_string(block.data() + 345, prefix_size, prefix);
+
+			std::memset(block.data() + 148, ' ', 8);
+			unsigned checksum{};
+			for (auto c : block)
+				checksum += static_cast<unsigned char>(c);
+			put_number(block.data() + 148, 7, checksum);
+		}
+	}  // namespace
+
+	writer::writer(io::writeable::ptr output, size_t chunk_size)
+	    : output_{std::move(output)}
+	    , chunk_(std::max(block_size(chunk_size), RECORDSIZE)) {
+		failed_ = !output_;
+	}
+
+	writer::~writer() { finish(); }
+
+	bool writer::begin(member const& header) {
+		if (failed_ || in_member_ || !output_) return false;
+
+		if (!type_flag(header)) return false;
+
+		auto copy = header;
+		if (copy.type != fs::file_type::regular || copy.hardlink) copy.size = 0;
+		if (copy.type == fs::file_type::directory && !copy.name.ends_with('/'))
+			copy.name.push_back('/');
+
+		if (!put_header(copy)) return false;
+
+		in_member_ = true;
+		remaining_ = copy.size;
+		return true;
+	}
+
+	bool writer::write(std::span<std::byte const> data) {
+		if (failed_ || !in_member_) return false;
+		if (data.size() > remaining_) {
+			failed_ = true;
+			return false;
+		}
+
+		remaining_ -= data.size();
+		return put(data);
+	}
+
+	bool writer::end() {
+		if (failed_ || !in_member_) return false;
+		in_member_ = false;
+
+		if (remaining_) {
+			failed_ = true;
+			return false;
+		}
+
+		return pad();
+	}
+
+	bool writer::add(member const& header, std::span<std::byte const> data) {
+		auto copy = header;
+		copy.size = data.size();
+		return begin(copy) && write(data) && end();
+	}
+
+	bool writer::add(member const& header, io::stream& source) {
+		if (!begin(header)) return false;
+
+		std::vector<std::byte> buffer(std::min(remaining_, chunk_.size()));
+		while (remaining_) {
+			auto const wanted = std::min(remaining_, buffer.size());
+			auto const read = source.read({buffer.data(), wanted});
+			if (!read) {
+				failed_ = true;
+				return false;
+			}
+			if (!write({buffer.data(), read})) return false;
+		}
+
+		return end();
+	}
+
+	bool writer::add_file(fs::path const& path, std::string const& name) {
+		impl::fs_member info{};
+		if (!impl::stat_member(path, info)) return false;
+
+		member header{};
+		header.name = name;
+		header.type = info.type;
+		header.permissions = info.permissions;
+		header.mtime = info.mtime;
+		header.linkname = std::move(info.linkname);
+		if (header.type != fs::file_type::regular)
+			return begin(header) && end();
+
+		header.size = info.size;
+		return begin(header) && copy_file(path, header.size) && end();
+	}
+
+	bool writer::add_tree(fs::path const& root, std::string const& prefix) {
+		return impl::walk_tree(root, prefix,
+		                       [this](fs::path const& path,
+		                              std::string const& name) {
+			                       return add_file(path, name);
+		                       });
+	}
+
+	bool writer::finish() {
+		if (!output_) return !failed_;
+
+		auto const result = !in_member_ && put(zeros) && drain();
+		output_->close();
+		output_.reset();
+		if (!result) failed_ = true;
+		return result;
+	}
+
+	bool writer::put(std::span<std::byte const> data) {
+		if (failed_ || !output_) return false;
+
+		while (!data.empty()) {
+			if (!fill_ && data.size() >= chunk_.size()) {
+				// whole chunks go straight to the output
+				auto const direct = data.size() - data.size() % chunk_.size();
+				if (output_->write(data.first(direct)) != direct) {
+					failed_ = true;
+					return false;
+				}
+				written_ += direct;
+				data = data.subspan(direct);
+				continue;
+			}
+
+			auto const chunk = std::min(chunk_.size() - fill_, data.size());
+			std::memcpy(chunk_.data() + fill_, data.data(), chunk);
+			fill_ += chunk;
+			written_ += chunk;
+			data = data.subspan(chunk);
+
+			if (fill_ == chunk_.size() && !drain()) return false;
+		}
+
+		return true;
+	}
+
+	bool writer::put_header(member const& header) {
+		auto const mode = static_cast<unsigned>(header.permissions) & 07777u;
+		auto const type = type_flag(header);
+
+		std::string_view prefix{}, name{};
+		std::string pax{};
+		if (!split_name(header.name, prefix, name)) {
+			pax_record(pax, "path", header.name);
+			name = std::string_view{header.name}.substr(0, name_size);
+		}
+		if (header.linkname.size() > name_size)
+			pax_record(pax, "linkpath", header.linkname);
+		if (header.size > (size_t{1} << (3 * (size_size - 1))) - 1)
+			pax_record(pax, "size", std::to_string(header.size));
+
+		record block{};
+		if (!pax.empty()) {
+			fill_header(block, {}, "././@PaxHeader", 0644, pax.size(),
+			            header.mtime, POSIX_XHDTYPE, {});
+			if (!put(std::as_bytes(std::span{block})) ||
+			    !put(std::as_bytes(std::span{pax})) || !pad())
+				return false;
+		}
+
+		fill_header(block, prefix, name, mode, header.size, header.mtime, type,
+		            header.linkname);
+		return put(std::as_bytes(std::span{block}));
+	}
+
+	bool writer::pad() {
+		auto const tail = written_ % RECORDSIZE;
+		if (!tail) return true;
+		return put({zeros, RECORDSIZE - tail});
+	}
+
+	bool writer::drain() {
+		if (!fill_) return true;
+		if (!output_) return false;
+
+		auto const written = output_->write({chunk_.data(), fill_});
+		if (written != fill_) {
+			failed_ = true;
+			return false;
+		}
+
+		fill_ = 0;
+		return true;
+	}
+
+	bool writer::copy_file(fs::path const& path, size_t size) {
+		size_t copied{};
+
+#ifdef __linux__
+		if (auto file = dynamic_cast<io::file*>(output_.get()); file && size) {
+			auto const in = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+			if (in >= 0 && drain() && !std::fflush(file->handle())) {
+				auto const out = fileno(file->handle());
+				static constexpr size_t max_chunk = 1u << 30;
+				bool use_copy_range = true;
+
+				while (copied < size) {
+					auto const chunk = std::min(size - copied, max_chunk);
+					auto const ret =
+					    use_copy_range ? ::copy_file_range(in, nullptr, out,
+					                                       nullptr, chunk, 0)
+					                   : ::sendfile(out, in, nullptr, chunk);
+					if (ret < 0 && use_copy_range &&
+					    (errno == EXDEV || errno == ENOSYS || errno == EINVAL ||
+					     errno == EOPNOTSUPP)) {
+						use_copy_range = false;
+						continue;
+					}
+					if (ret <= 0) break;
+					copied += static_cast<size_t>(ret);
+				}
+
+				// the FILE still remembers the offset from before the copy
+				auto const offset = ::lseek(out, 0, SEEK_CUR);
+				if (offset >= 0) ::fseeko(file->handle(), offset, SEEK_SET);
+
+				written_ += copied;
+				remaining_ -= copied;
+			}
+			if (in >= 0) ::close(in);
+			if (failed_) return false;
+		}
+#endif
+
+		if (copied == size) return true;
+
+		auto source = io::file::open(path);
+		if (!source || source->seek(copied) != copied) {
+			failed_ = true;
+			return false;
+		}
+
+		std::vector<std::byte> buffer(chunk_.size());
+		while (copied < size) {
+			auto const wanted = std::min(size - copied, buffer.size());
+			auto const read = source->read({buffer.data(), wanted});
+			if (!read) {
+				failed_ = true;
+				return false;
+			}
+			if (!write({buffer.data(), read})) return false;
+			copied += read;
+		}
+
+		return true;
+	}
+}  // namespace arch::tar
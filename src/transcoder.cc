@@ -0,0 +1,325 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include <arch/io/file.hh>
+#include <arch/transcoder.hh>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace arch {
+	namespace {
+		enum class part {
+			// start of a member; regular files are followed by the contents
+			// and one of the terminators
+			header,
+			contents,
+			end,
+			damaged,
+			failed,
+			// no more members
+			done,
+		};
+
+		struct message {
+			part kind{part::done};
+			fs::path name{};
+			io::status status{};
+			fs::path linkname{};
+			std::vector<std::byte> data{};
+		};
+
+		class channel {
+		public:
+			explicit channel(size_t depth) : depth_{depth} {}
+
+			// false, if the reading side gave up
+			bool push(message&& msg) {
+				std::unique_lock lock{m_};
+				cv_.wait(lock, [this] {
+					return cancelled_ || queue_.size() < depth_;
+				});
+				if (cancelled_) return false;
+				queue_.push_back(std::move(msg));
+				cv_.notify_all();
+				return true;
+			}
+
+			message pop() {
+				std::unique_lock lock{m_};
+				cv_.wait(lock, [this] { return !queue_.empty(); });
+				auto msg = std::move(queue_.front());
+				queue_.pop_front();
+				cv_.notify_all();
+				return msg;
+			}
+
+			void cancel() {
+				std::lock_guard lock{m_};
+				cancelled_ = true;
+				queue_.clear();
+				cv_.notify_all();
+			}
+
+		private:
+			std::mutex m_{};
+			std::condition_variable cv_{};
+			std::deque<message> queue_{};
+			size_t depth_;
+			bool cancelled_{false};
+		};
+
+		void decode(base::archive& archive, channel& pipe) {
+			auto const entry_count = archive.count();
+			for (size_t ndx = 0; ndx < entry_count; ++ndx) {
+				auto entry = archive.entry(ndx);
+				if (!entry) continue;
+
+				auto const& status = entry->file_status();
+				if (!pipe.push({.kind = part::header,
+				                .name = entry->filename(),
+				                .status = status,
+				                .linkname = entry->linkname()}))
+					return;
+
+				if (status.type != fs::file_type::regular || status.hardlink)
+					continue;
+
+				auto input = entry->file();
+				auto remaining = status.size;
+				auto result = input ? part::end : part::failed;
+				while (input && remaining) {
+					std::vector<std::byte> chunk(
+					    std::min(remaining, uintmax_t{transcoder::chunk_size}));
+					auto const extracted = input->read(chunk);
+					if (!extracted) {
+						result = part::failed;
+						break;
+					}
+					chunk.resize(extracted);
+					remaining -= extracted;
+					if (!pipe.push({.kind = part::contents,
+					                .data = std::move(chunk)}))
+						return;
+				}
+
+				if (result == part::end &&
+				    input->verification() == verify_result::damaged)
+					result = part::damaged;
+				if (!pipe.push({.kind = result})) return;
+			}
+
+			pipe.push({.kind = part::done});
+		}
+
+		// Contents of a single member, as they arrive from the decoder
+		class pipe_stream final : public io::stream_mixin {
+		public:
+			pipe_stream(channel& pipe,
+			            io::status const& status,
+			            fs::path const& linkname)
+			    : io::stream_mixin{status, status, linkname}, pipe_{pipe} {}
+
+			void close() final {}
+
+			std::size_t read(std::span<std::byte> output) final {
+				while (pos_ == buffer_.size() && result_ == part::contents) {
+					auto msg = pipe_.pop();
+					result_ = msg.kind;
+					buffer_ = std::move(msg.data);
+					pos_ = 0;
+				}
+
+				auto const chunk =
+				    std::min(output.size(), buffer_.size() - pos_);
+				if (chunk)
+					std::memcpy(output.data(), buffer_.data() + pos_, chunk);
+				pos_ += chunk;
+				return chunk;
+			}
+
+			// consumes what is left of the member
+			part finish() {
+				while (result_ == part::contents)
+					result_ = pipe_.pop().kind;
+				return result_;
+			}
+
+			verify_result verification() final {
+				return finish() == part::damaged ? verify_result::damaged
+				                                    : verify_result::valid;
+			}
+
+		private:
+			channel& pipe_;
+			std::vector<std::byte> buffer_{};
+			size_t pos_{};
+			part result_{part::contents};
+		};
+
+		class empty_stream final : public io::stream_mixin {
+		public:
+			using io::stream_mixin::stream_mixin;
+			void close() final {}
+		};
+	}  // namespace
+
+	transcoder::~transcoder() = default;
+
+	fs::path transcoder::modify_path(fs::path const& filename) const {
+		return filename;
+	}
+
+	void transcoder::on_error(fs::path const& filename,
+	                          char const* msg) const {
+		std::fprintf(stderr, "%s: error: %s\n", filename.string().c_str(),
+		             msg);
+	}
+	void transcoder::on_note(char const* msg) const {
+		std::fprintf(stderr, "  note: %s\n", msg);
+	}
+
+	bool transcoder::transcode(fs::path const& path) const {
+		auto file = io::file::open(path);
+		if (!file) {
+			on_error(path, "cannot open");
+			return false;
+		}
+
+		base::archive::ptr archive{};
+		auto const result = open(std::move(file), archive, format_hint{path});
+		switch (result) {
+			case open_status::compression_damaged:
+				on_error(path, "file compression damaged");
+				return false;
+			case open_status::archive_damaged:
+				on_error(path, "archive damaged");
+				return false;
+			case open_status::archive_unknown:
+				on_error(path, "unrecognized archive");
+				return false;
+			case open_status::ok:
+				break;
+		}
+
+		if (!archive) {
+			on_error(path, "unknown internal issue");
+			return false;
+		}
+
+		return transcode(*archive);
+	}
+
+	bool transcoder::transcode(base::archive& archive) const {
+		channel pipe{queue_depth};
+		std::thread decoder{[&] { decode(archive, pipe); }};
+
+		auto result = true;
+		while (result) {
+			auto msg = pipe.pop();
+			if (msg.kind == part::done) break;
+			// anything else would have been consumed by a pipe_stream
+			if (msg.kind != part::header) {
+				result = false;
+				break;
+			}
+
+			auto const name = modify_path(msg.name);
+			auto const is_contents =
+			    msg.status.type == fs::file_type::regular &&
+			    !msg.status.hardlink;
+			if (!is_contents) {
+				if (name.empty()) continue;
+				empty_stream contents{msg.status, msg.status, msg.linkname};
+				result = write(name, msg.status, msg.linkname, contents);
+				if (!result) on_error(name, "cannot write file");
+				continue;
+			}
+
+			pipe_stream contents{pipe, msg.status, msg.linkname};
+			auto const written =
+			    name.empty() || write(name, msg.status, msg.linkname, contents);
+
+			// a failed read also fails the write, which only sees the
+			// contents end too early; the decoder's side is the cause then
+			switch (contents.finish()) {
+				case part::end:
+					if (!written) on_error(name, "cannot write file");
+					result = written;
+					break;
+				case part::damaged:
+					on_error(msg.name, "integrity check failed");
+					result = false;
+					break;
+				default:
+					on_error(msg.name, "cannot read file");
+					result = false;
+					break;
+			}
+		}
+
+		pipe.cancel();
+		decoder.join();
+		return result;
+	}
+
+	bool transcoder::write(fs::path const& name,
+	                       io::status const& status,
+	                       fs::path const& linkname,
+	                       io::stream& contents) const {
+		switch (status.type) {
+			case fs::file_type::regular:
+			case fs::file_type::directory:
+			case fs::file_type::symlink:
+				break;
+			default:
+				on_note(("skipping special file " + name.string()).c_str());
+				return true;
+		}
+
+		size_t const size = status.size;
+		auto const mtime = std::chrono::system_clock::to_time_t(
+		    base::io::to_system_clock(status.last_write_time));
+		auto const perms = status.permissions & fs::perms::mask;
+		auto const is_link =
+		    status.type == fs::file_type::symlink || status.hardlink;
+		auto const target = is_link ? linkname.generic_string() : std::string{};
+
+		bool result = false;
+		if (tar_) {
+			tar::member header{.name = name.generic_string(),
+			                   .type = status.type,
+			                   .permissions = perms,
+			                   .size = size,
+			                   .mtime = mtime,
+			                   .linkname = target,
+			                   .hardlink = status.hardlink};
+			if (status.type == fs::file_type::regular && !status.hardlink)
+				result = tar_->add(header, contents);
+			else
+				result = tar_->add(header, std::span<std::byte const>{});
+		} else if (zip_) {
+			zip::member header{.name = name.generic_string(),
+			                   .type = status.type,
+			                   .permissions = perms,
+			                   .mtime = mtime};
+			if (status.hardlink) {
+				on_note(("zip has no hard links, skipping " + header.name +
+				         " (linked to " + target + ")")
+				            .c_str());
+				return true;
+			}
+			if (status.type == fs::file_type::regular)
+				result = zip_->add(header, contents, size);
+			else
+				result = zip_->add(header, std::as_bytes(std::span{target}));
+		}
+
+		return result;
+	}
+}  // namespace arch
@@ -48,7 +48,7 @@ namespace arch {
 		}
 
 		base::archive::ptr archive{};
-		auto const result = open(std::move(file), archive);
+		auto const result = open(std::move(file), archive, format_hint{path});
 		switch (result) {
 			case open_status::compression_damaged:
 				on_error(path, "file compression damaged");
@@ -124,9 +124,44 @@ namespace arch {
 		bool expand_entry(base::io::stream& src,
 		                  io::file& dst,
 		                  base::io::status const& status) {
+			auto const sparse_map = src.sparse_map();
+			if (sparse_map.empty()) return copy(src, dst, status.size);
+
+			// The output is new, so seeking over the holes leaves them
+			// unallocated; they are skipped in the source, too.
+			uintmax_t pos{};
+			uintmax_t written{};
+			for (auto const& extent : sparse_map) {
+				if (extent.offset > pos) {
+					size_t const hole = extent.offset - pos;
+					if (src.skip(hole) != hole) return false;
+					pos = extent.offset;
+				}
+				if (!extent.size) continue;
+
+				size_t const offset = extent.offset;
+				if (dst.seek(offset) != offset ||
+				    !copy(src, dst, extent.size))
+					return false;
+				pos += extent.size;
+				written = pos;
+			}
+
+			// a hole at the end still counts to the size of the file
+			if (written < status.size) {
+				static constexpr std::byte zero[1]{};
+				size_t const last = status.size - 1;
+				if (dst.seek(last) != last || dst.write(zero) != 1)
+					return false;
+			}
+			return true;
+		}
+
+		static bool copy(base::io::stream& src,
+		                 io::file& dst,
+		                 uintmax_t size) {
 			thread_local std::array<std::byte, expected_size> buffer{};
 			auto view = std::span{buffer.data(), buffer.size()};
-			auto size = status.size;
 			bool copied = true;
 			while (size) {
 				auto chunk = buffer.size();
@@ -150,7 +185,7 @@ namespace arch {
 			return copied;
 		}
 
-		enum result { ok, copy_issues, setup_issues };
+		enum result { ok, copy_issues, integrity_issues, setup_issues };
 		result expand(unpacker const& self, base::entry const& entry) {
 			auto input = expander::open_entry(entry);
 			if (!input) return setup_issues;
@@ -162,13 +197,16 @@ namespace arch {
 
 			auto const copied =
 			    expand_entry(*input, *output, entry.file_status());
-			return copied ? ok : copy_issues;
+			if (!copied) return copy_issues;
+			if (input->verification() == verify_result::damaged)
+				return integrity_issues;
+			return ok;
 		}
 
-		void clean(unpacker const& self) const {
+		void clean(unpacker const& self, char const* msg) const {
 			std::error_code ignore;
 			fs::remove(name, ignore);
-			self.on_error(name, "cannot extract file");
+			self.on_error(name, msg);
 		}
 
 		void copy_attributes(base::io::status const& status) {
@@ -186,7 +224,10 @@ namespace arch {
 			return true;
 		}
 
-		if (result == expander::copy_issues) exp.clean(*this);
+		if (result == expander::copy_issues)
+			exp.clean(*this, "cannot extract file");
+		else if (result == expander::integrity_issues)
+			exp.clean(*this, "integrity check failed");
 		return false;
 	}
 
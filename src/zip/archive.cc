@@ -186,18 +186,48 @@ namespace arch::zip {
 		return result;
 	}
 
-	bool archive::open(io::seekable::ptr file) {
+	bool archive::is_valid(std::span<std::byte const> prefix) {
+		// archives with anything before the first local header, or without
+		// any entries, are only found by the seekable version
+		return check_signature<'P', 'K', 0x03, 0x04>(prefix);
+	}
+
+	std::unique_ptr<archive> archive::try_open(io::seekable::ptr& file,
+	                                           open_options const& opts) {
+		if (!file) return {};
+		file->seek(0);
+
+		void* handle;
+		zip_source_t* source;
+
+		if (!open(file.get(), &handle, &source, opts.check_consistency)) {
+			if (handle) zip_close(get_handle(handle));
+			if (source) zip_source_close(source);
+			return {};
+		}
+
+		auto result = std::make_unique<archive>();
+		result->file_ = std::move(file);
+		result->handle_ = handle;
+		result->source_ = source;
+		result->policy_ = opts.integrity;
+		return result;
+	}
+
+	bool archive::open(io::seekable::ptr file, open_options const& opts) {
 		close();
 
 		file_ = std::move(file);
+		policy_ = opts.integrity;
 		if (!file_) return false;
 
-		return open(file_.get(), &handle_, &source_);
+		return open(file_.get(), &handle_, &source_, opts.check_consistency);
 	}
 
 	bool archive::open(io::seekable* file,
 	                   void** handle,
-	                   zip_source_t** source) {
+	                   zip_source_t** source,
+	                   bool check_consistency) {
 		*handle = nullptr;
 		*source = nullptr;
 
@@ -211,8 +241,9 @@ namespace arch::zip {
 		if (!*source) return false;
 		cb.release();
 
-		get_handle(*handle) =
-		    zip_open_from_source(*source, ZIP_CHECKCONS | ZIP_RDONLY, nullptr);
+		auto const flags =
+		    check_consistency ? ZIP_CHECKCONS | ZIP_RDONLY : ZIP_RDONLY;
+		get_handle(*handle) = zip_open_from_source(*source, flags, nullptr);
 		return !!*handle;
 	}
 
@@ -237,6 +268,15 @@ namespace arch::zip {
 		if (zip_stat_index(HANDLE, index, ZIP_FL_UNCHANGED, &st) ||
 		    (st.valid & expected) != expected)
 			return {};
-		return std::make_unique<zip::entry>(HANDLE, index, st);
+		return std::make_unique<zip::entry>(HANDLE, index, st, policy_);
+	}
+
+	base::entry::ptr archive::find(std::string_view name) const {
+		// the names are looked up in the central directory, already read
+		std::string const zipped{name};
+		auto const index =
+		    zip_name_locate(HANDLE, zipped.c_str(), ZIP_FL_UNCHANGED);
+		if (index < 0) return {};
+		return entry(static_cast<size_t>(index));
 	}
 }  // namespace arch::zip
@@ -1,6 +1,7 @@
 // Copyright (c) 2020 midnightBITS
 // This code is licensed under MIT license (see LICENSE for details)
 
+#include <arch/inflate.hh>
 #include <arch/zip/entry.hh>
 #include <arch/zip/stream.hh>
 
@@ -12,20 +13,108 @@ namespace arch::zip {
 			        fs::perms::owner_read | fs::perms::owner_write |
 			            fs::perms::group_read | fs::perms::others_read};
 		}
+
+		bool decodable(zip_stat_t const& st) {
+			static constexpr auto expected =
+			    ZIP_STAT_CRC | ZIP_STAT_COMP_SIZE | ZIP_STAT_COMP_METHOD |
+			    ZIP_STAT_ENCRYPTION_METHOD;
+			if ((st.valid & expected) != expected) return false;
+			if (st.encryption_method != ZIP_EM_NONE) return false;
+			return st.comp_method == ZIP_CM_STORE ||
+			       st.comp_method == ZIP_CM_DEFLATE;
+		}
 	}  // namespace
 
-	entry::entry(zip_t* handle, size_t index, zip_stat_t const& st)
+	entry::entry(zip_t* handle,
+	             size_t index,
+	             zip_stat_t const& st,
+	             verify policy)
 	    : base::dos_entry_mixin{from_zip(st)}
 	    , handle_{handle}
 	    , index_{index}
-	    , filename_{st.name} {}
+	    , filename_{st.name}
+	    , policy_{policy}
+	    , raw_{decodable(st)}
+	    , method_{st.comp_method}
+	    , crc_{st.crc}
+	    , compressed_{st.comp_size} {}
 
 	fs::path const& entry::filename() const { return filename_; }
 
 	io::stream::ptr entry::file() const {
+		if (raw_) {
+			auto file = stream::zip_file{zip_fopen_index(
+			    handle_, index_, ZIP_FL_UNCHANGED | ZIP_FL_COMPRESSED)};
+			if (!file) return {};
+			return std::make_unique<stream>(std::move(file), linked_status(),
+			                                stream::raw_entry{method_, crc_},
+			                                policy_);
+		}
+
 		auto file = stream::zip_file{
 		    zip_fopen_index(handle_, index_, ZIP_FL_UNCHANGED)};
 		if (!file) return {};
 		return std::make_unique<stream>(std::move(file), linked_status());
 	}
+
+	bool entry::is_deflated() const noexcept {
+		return method_ == ZIP_CM_DEFLATE;
+	}
+
+	io::stream::ptr entry::compressed_file() const {
+		if (!raw_) return {};
+
+		auto file = stream::zip_file{zip_fopen_index(
+		    handle_, index_, ZIP_FL_UNCHANGED | ZIP_FL_COMPRESSED)};
+		if (!file) return {};
+
+		auto status = linked_status();
+		status.size = compressed_;
+		return std::make_unique<stream>(std::move(file), status);
+	}
+
+	bool entry::external_attributes(uint8_t& system,
+	                                uint32_t& attributes) const noexcept {
+		return !zip_file_get_external_attributes(
+		    handle_, index_, ZIP_FL_UNCHANGED, &system, &attributes);
+	}
+
+	bool entry::read_into(std::span<std::byte> output) const {
+		if (!raw_) return base::entry::read_into(output);
+		if (output.size() != file_status().size) return false;
+
+		auto file = stream::zip_file{zip_fopen_index(
+		    handle_, index_, ZIP_FL_UNCHANGED | ZIP_FL_COMPRESSED)};
+		if (!file) return false;
+
+		auto const read_whole = [&file](std::span<std::byte> buffer) {
+			while (!buffer.empty()) {
+				auto const ret =
+				    zip_fread(file.get(), buffer.data(), buffer.size());
+				if (ret <= 0) return false;
+				buffer = buffer.subspan(static_cast<size_t>(ret));
+			}
+			return true;
+		};
+
+		if (method_ == ZIP_CM_STORE) {
+			if (!read_whole(output)) return false;
+		} else {
+			// reused between the calls, the members are usually small; a
+			// large one gets a buffer of its own, so that it does not stay
+			// with the thread
+			static constexpr uint64_t reused_limit = 1024 * 1024;
+			thread_local std::vector<std::byte> reused{};
+			std::vector<std::byte> own{};
+			auto& compressed = compressed_ <= reused_limit ? reused : own;
+			compressed.resize(compressed_);
+			if (!read_whole(compressed)) return false;
+
+			size_t used{};
+			if (!inflate::decode_all(compressed, output, used)) return false;
+		}
+
+		if (policy_ == verify::trusted) return true;
+		return zlib::crc32_update(::crc32(0, nullptr, 0), output) == crc_;
+	}
 }  // namespace arch::zip
@@ -1,21 +1,110 @@
 // Copyright (c) 2020 midnightBITS
 // This code is licensed under MIT license (see LICENSE for details)
 
+#include <arch/inflate.hh>
 #include <arch/zip/stream.hh>
 
 namespace arch::zip {
 	stream::stream(zip_file&& handle, io::status const& status)
 	    : io::dos_stream_mixin{status}, handle_{std::move(handle)} {}
 
+	stream::stream(zip_file&& handle,
+	               io::status const& status,
+	               raw_entry const& raw,
+	               verify policy)
+	    : io::dos_stream_mixin{status}
+	    , handle_{std::move(handle)}
+	    , raw_{true}
+	    , crc_{raw.crc}
+	    , check_{policy} {
+		if (raw.method == ZIP_CM_DEFLATE) {
+			decompressor_ = inflate::make_decompressor();
+			input_.resize(32 * 1024);
+		}
+		check_.start();
+	}
+
 	stream::~stream() { close(); }
 
 	void stream::close() { handle_.reset(); }
 
 	std::size_t stream::read(std::span<std::byte> bytes) {
-		if (bytes.empty()) return 0;
+		if (bytes.empty() || !handle_) return 0;
+		return raw_ ? read_raw(bytes) : read_libzip(bytes);
+	}
+
+	verify_result stream::verification() {
+		if (damaged_) return verify_result::damaged;
+		if (raw_) return check_.result();
+		// libzip compares the CRC, once it sees the end of the entry
+		return libzip_checked_ ? verify_result::valid
+		                       : verify_result::unchecked;
+	}
 
+	std::size_t stream::read_libzip(std::span<std::byte> bytes) {
 		auto ret = zip_fread(handle_.get(), bytes.data(), bytes.size());
-		if (ret < 0) return 0;
+		if (ret < 0) {
+			damaged_ = true;
+			return 0;
+		}
+		if (!ret) libzip_checked_ = true;
 		return static_cast<size_t>(ret);
 	}
+
+	std::size_t stream::read_raw(std::span<std::byte> bytes) {
+		auto const size = file_status().size;
+		if (pos_ >= size || damaged_) return 0;
+		if (bytes.size() > size - pos_) bytes = bytes.subspan(0, size - pos_);
+
+		size_t result{};
+		if (decompressor_) {
+			result = inflate(bytes);
+		} else {
+			auto const ret =
+			    zip_fread(handle_.get(), bytes.data(), bytes.size());
+			if (ret < 0)
+				damaged_ = true;
+			else
+				result = static_cast<size_t>(ret);
+		}
+
+		check_.update(bytes.subspan(0, result));
+		pos_ += result;
+
+		if (pos_ == size)
+			check_.finish(crc_, size);
+		else if (!result)
+			damaged_ = true;  // entry is shorter, than the directory says
+
+		return result;
+	}
+
+	std::size_t stream::inflate(std::span<std::byte> bytes) {
+		size_t result{};
+		while (result < bytes.size() && !decompressor_->eof()) {
+			if (input_pos_ == input_end_) {
+				auto const ret =
+				    zip_fread(handle_.get(), input_.data(), input_.size());
+				if (ret <= 0) {
+					if (ret < 0) damaged_ = true;
+					break;
+				}
+				input_pos_ = 0;
+				input_end_ = static_cast<size_t>(ret);
+			}
+
+			auto const [decompressed, used] = decompressor_->decompress(
+			    {input_.data() + input_pos_, input_end_ - input_pos_},
+			    bytes.subspan(result));
+			input_pos_ += used;
+			result += decompressed;
+
+			if (decompressor_->damaged()) {
+				damaged_ = true;
+				break;
+			}
+			if (!decompressed && !used) break;
+		}
+		return result;
+	}
 }  // namespace arch::zip
@@ -0,0 +1,616 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include <arch/io/file.hh>
+#include <arch/zip/archive.hh>
+#include <arch/zip/entry.hh>
+#include <arch/zip/writer.hh>
+#include <arch/zlib.hh>
+#include "fs_tree.hh"
+#include "parallel.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+
+namespace arch::zip {
+	namespace {
+		constexpr unsigned long local_signature = 0x04034b50;
+		constexpr unsigned long central_signature = 0x02014b50;
+		constexpr unsigned long descriptor_signature = 0x08074b50;
+		constexpr unsigned long zip64_end_signature = 0x06064b50;
+		constexpr unsigned long zip64_locator_signature = 0x07064b50;
+		constexpr unsigned long end_signature = 0x06054b50;
+
+		constexpr unsigned version_default = 20;
+		constexpr unsigned version_zip64 = 45;
+		constexpr unsigned made_by_unix = 3 << 8;
+
+		constexpr unsigned flag_descriptor = 1 << 3;
+		constexpr unsigned flag_utf8 = 1 << 11;
+
+		constexpr unsigned method_store = 0;
+		constexpr unsigned method_deflate = 8;
+
+		constexpr unsigned zip64_extra_id = 0x0001;
+		constexpr unsigned timestamp_extra_id = 0x5455;
+
+		constexpr size_t max_16 = 0xFFFF;
+		constexpr size_t max_32 = 0xFFFFFFFF;
+		constexpr size_t stream_chunk = 1024 * 1024;
+
+		void put_le(std::vector<std::byte>& out,
+		            uintmax_t value,
+		            size_t width) {
+			for (size_t index = 0; index < width; ++index) {
+				out.push_back(static_cast<std::byte>(value & 0xFF));
+				value >>= 8;
+			}
+		}
+
+		void put_string(std::vector<std::byte>& out, std::string_view value) {
+			auto const bytes = std::as_bytes(std::span{value});
+			out.insert(out.end(), bytes.begin(), bytes.end());
+		}
+
+		// DOS time and date, in local time, clamped to 1980-2107
+		std::pair<unsigned, unsigned> dos_date_time(time_t mtime) {
+			std::tm tm{};
+#ifdef _WIN32
+			if (localtime_s(&tm, &mtime)) return {0, (1 << 5) | 1};
+#else
+			if (!localtime_r(&mtime, &tm)) return {0, (1 << 5) | 1};
+#endif
+			if (tm.tm_year < 80) return {0, (1 << 5) | 1};
+			if (tm.tm_year > 207)
+				return {(23 << 11) | (59 << 5) | 29,
+				        (127 << 9) | (12 << 5) | 31};
+
+			auto const time = (tm.tm_hour << 11) | (tm.tm_min << 5) |
+			                  (tm.tm_sec / 2);
+			auto const date =
+			    ((tm.tm_year - 80) << 9) | ((tm.tm_mon + 1) << 5) | tm.tm_mday;
+			return {static_cast<unsigned>(time), static_cast<unsigned>(date)};
+		}
+
+		// extended timestamp, only for the times the field can hold
+		bool has_timestamp(time_t mtime) {
+			return mtime > 0 && static_cast<uintmax_t>(mtime) <= max_32;
+		}
+
+		void put_timestamp(std::vector<std::byte>& out, time_t mtime) {
+			put_le(out, timestamp_extra_id, 2);
+			put_le(out, 5, 2);
+			put_le(out, 1, 1);
+			put_le(out, static_cast<uintmax_t>(mtime), 4);
+		}
+
+		unsigned flags_for(std::string_view name, bool streamed) {
+			unsigned flags = streamed ? flag_descriptor : 0;
+			for (auto c : name) {
+				if (static_cast<unsigned char>(c) & 0x80) {
+					flags |= flag_utf8;
+					break;
+				}
+			}
+			return flags;
+		}
+
+		unsigned long external_attributes(member const& header) {
+			auto const mode = static_cast<unsigned long>(header.permissions) &
+			                  07777u;
+			switch (header.type) {
+				case fs::file_type::directory:
+					return ((0040000u | mode) << 16) | 0x10;
+				case fs::file_type::symlink:
+					return (0120000u | 0777u) << 16;
+				default:
+					break;
+			}
+			return (0100000u | mode) << 16;
+		}
+
+		// sizes the deflate stream may reach, before zip64 is unavoidable
+		bool needs_zip64(size_t size) {
+			return size >= max_32 - (size >> 10) - 1024;
+		}
+
+		// Raw deflate into a buffer the size of the input; whatever does
+		// not fit, is not worth deflating and is stored instead.
+		void deflate_job(std::vector<std::byte> const& data,
+		                 std::vector<std::byte>& packed,
+		                 unsigned long& crc,
+		                 bool& deflated,
+		                 int level) {
+			crc = zlib::crc32_update(::crc32(0, nullptr, 0), data);
+			deflated = false;
+			if (!level || data.empty()) return;
+
+			thread_local std::unique_ptr<zlib::compressor> local{};
+			thread_local int local_level{};
+			if (!local || local_level != level || !local->reset()) {
+				local = std::make_unique<zlib::compressor>(level,
+				                                           zlib::format::raw);
+				local_level = level;
+			}
+
+			packed.resize(data.size());
+			std::span<std::byte const> input{data};
+			size_t used{};
+			while (!local->finished() && !local->failed() &&
+			       used < packed.size()) {
+				auto const [produced, consumed] =
+				    local->compress(input, std::span{packed}.subspan(used),
+				                    base::flush_mode::finish);
+				used += produced;
+				input = input.subspan(consumed);
+				if (!produced && !consumed) break;
+			}
+
+			if (local->finished() && used < data.size()) {
+				packed.resize(used);
+				deflated = true;
+				return;
+			}
+
+			packed.clear();
+			packed.shrink_to_fit();
+		}
+	}  // namespace
+
+	writer::writer(io::writeable::ptr output, int level, size_t batch_size)
+	    : output_{std::move(output)}
+	    , level_{std::clamp(level, 0, 9)}
+	    , batch_size_{std::max(batch_size, size_t{1024 * 1024})} {
+		failed_ = !output_;
+	}
+
+	writer::~writer() { finish(); }
+
+	bool writer::add(member const& header, std::vector<std::byte>&& data) {
+		if (failed_ || !output_) return false;
+		if (header.name.empty() || header.name.size() >= max_16) return false;
+
+		auto& item = batch_.emplace_back();
+		item.header = header;
+		switch (header.type) {
+			case fs::file_type::directory:
+				if (!item.header.name.ends_with('/'))
+					item.header.name.push_back('/');
+				break;
+			case fs::file_type::regular:
+			case fs::file_type::symlink:
+				item.data = std::move(data);
+				break;
+			default:
+				batch_.pop_back();
+				return false;
+		}
+
+		batch_fill_ += item.data.size();
+		if (batch_fill_ >= batch_size_) return flush_batch();
+		return true;
+	}
+
+	bool writer::add(member const& header, std::span<std::byte const> data) {
+		return add(header, std::vector<std::byte>{data.begin(), data.end()});
+	}
+
+	bool writer::add(member const& header, io::stream& source, size_t size) {
+		if (failed_ || !output_) return false;
+
+		if (header.type == fs::file_type::regular && size > batch_size_) {
+			if (header.name.empty() || header.name.size() >= max_16)
+				return false;
+			return flush_batch() && stream(header, source, size);
+		}
+
+		std::vector<std::byte> data(size);
+		size_t read{};
+		while (read < size) {
+			auto const chunk =
+			    source.read(std::span{data}.subspan(read, size - read));
+			if (!chunk) return false;
+			read += chunk;
+		}
+
+		return add(header, std::move(data));
+	}
+
+	bool writer::add_raw(raw_member const& info, io::stream& compressed) {
+		if (failed_ || !output_) return false;
+
+		auto header = info.header;
+		if (header.name.empty() || header.name.size() >= max_16) return false;
+		if (header.type == fs::file_type::directory &&
+		    !header.name.ends_with('/'))
+			header.name.push_back('/');
+
+		// the members added before must come first
+		if (!flush_batch()) return false;
+
+		record const entry{
+		    .header = &header,
+		    .crc = info.crc,
+		    .deflated = info.deflated,
+		    .streamed = false,
+		    .zip64 = info.size >= max_32 || info.compressed_size >= max_32,
+		    .compressed = info.compressed_size,
+		    .size = info.size,
+		};
+
+		auto const local_offset = offset_;
+		if (!put_local(entry)) return false;
+
+		std::vector<std::byte> buffer(
+		    std::min(info.compressed_size, stream_chunk));
+		auto remaining = info.compressed_size;
+		while (remaining) {
+			auto const chunk = compressed.read(
+			    {buffer.data(), std::min(remaining, buffer.size())});
+			if (!chunk) {
+				failed_ = true;
+				return false;
+			}
+			if (!put({buffer.data(), chunk})) return false;
+			remaining -= chunk;
+		}
+
+		put_central(entry, local_offset);
+		return true;
+	}
+
+	bool writer::merge(zip::archive const& source) {
+		auto const entry_count = source.count();
+		for (size_t index = 0; index < entry_count; ++index) {
+			auto const generic = source.entry(index);
+			auto const* entry = dynamic_cast<zip::entry const*>(generic.get());
+			if (!entry) continue;
+
+			auto const& status = entry->file_status();
+			auto const name = entry->filename().generic_string();
+			member header{
+			    .name = name,
+			    .type = name.ends_with('/') ? fs::file_type::directory
+			                                : fs::file_type::regular,
+			    .permissions = status.permissions,
+			    .mtime = std::chrono::system_clock::to_time_t(
+			        base::io::to_system_clock(status.last_write_time)),
+			};
+
+			// the mode, the exec bits and the symlinks are kept only there
+			uint8_t system{};
+			uint32_t external{};
+			if (entry->external_attributes(system, external))
+				header.copied = attributes{system, external};
+
+			if (entry->is_raw()) {
+				auto compressed = entry->compressed_file();
+				if (!compressed ||
+				    !add_raw({.header = header,
+				              .deflated = entry->is_deflated(),
+				              .crc = entry->crc(),
+				              .size = status.size,
+				              .compressed_size = entry->compressed_size()},
+				             *compressed))
+					return false;
+				continue;
+			}
+
+			auto contents = entry->file();
+			if (!contents || !add(header, *contents, status.size)) return false;
+		}
+
+		return true;
+	}
+
+	bool writer::add_file(fs::path const& path, std::string const& name) {
+		impl::fs_member info{};
+		if (!impl::stat_member(path, info)) return false;
+
+		member header{};
+		header.name = name;
+		header.type = info.type;
+		header.permissions = info.permissions;
+		header.mtime = info.mtime;
+
+		switch (header.type) {
+			case fs::file_type::regular: {
+				auto file = io::file::open(path);
+				if (!file) return false;
+				return add(header, *file, info.size);
+			}
+			case fs::file_type::symlink:
+				return add(header, std::as_bytes(std::span{info.linkname}));
+			default:
+				return add(header, std::vector<std::byte>{});
+		}
+	}
+
+	bool writer::add_tree(fs::path const& root, std::string const& prefix) {
+		return impl::walk_tree(root, prefix,
+		                       [this](fs::path const& path,
+		                              std::string const& name) {
+			                       return add_file(path, name);
+		                       });
+	}
+
+	bool writer::finish() {
+		if (!output_) return !failed_;
+
+		auto result = flush_batch();
+		if (result) {
+			auto const central_offset = offset_;
+			auto const central_size = central_.size();
+			result = put(central_);
+
+			std::vector<std::byte> end{};
+			auto const zip64 = entries_ >= max_16 || central_size >= max_32 ||
+			                   central_offset >= max_32;
+			if (zip64) {
+				auto const record_offset = central_offset + central_size;
+				put_le(end, zip64_end_signature, 4);
+				put_le(end, 44, 8);
+				put_le(end, made_by_unix | version_zip64, 2);
+				put_le(end, version_zip64, 2);
+				put_le(end, 0, 4);
+				put_le(end, 0, 4);
+				put_le(end, entries_, 8);
+				put_le(end, entries_, 8);
+				put_le(end, central_size, 8);
+				put_le(end, central_offset, 8);
+
+				put_le(end, zip64_locator_signature, 4);
+				put_le(end, 0, 4);
+				put_le(end, record_offset, 8);
+				put_le(end, 1, 4);
+			}
+
+			put_le(end, end_signature, 4);
+			put_le(end, 0, 2);
+			put_le(end, 0, 2);
+			put_le(end, std::min(entries_, max_16), 2);
+			put_le(end, std::min(entries_, max_16), 2);
+			put_le(end, std::min(central_size, max_32), 4);
+			put_le(end, std::min(central_offset, max_32), 4);
+			put_le(end, 0, 2);
+			result = result && put(end);
+		}
+
+		output_->close();
+		output_.reset();
+		central_.clear();
+		if (!result) failed_ = true;
+		return result;
+	}
+
+	bool writer::flush_batch() {
+		if (failed_ || !output_) return false;
+		if (batch_.empty()) return true;
+
+		// the members are written while the ones after them are still
+		// being deflated
+		auto result = true;
+		auto const pack = [this](size_t index) {
+			auto& item = batch_[index];
+			deflate_job(item.data, item.packed, item.crc, item.deflated,
+			            level_);
+		};
+		auto const write = [this, &result](size_t index) {
+			auto& item = batch_[index];
+			if (!result) return;
+
+			auto const& data = item.deflated ? item.packed : item.data;
+			record const entry{
+			    .header = &item.header,
+			    .crc = item.crc,
+			    .deflated = item.deflated,
+			    .streamed = false,
+			    .zip64 = data.size() >= max_32 || item.data.size() >= max_32,
+			    .compressed = data.size(),
+			    .size = item.data.size(),
+			};
+
+			auto const local_offset = offset_;
+			if (!put_local(entry) || !put(data)) {
+				result = false;
+				return;
+			}
+			put_central(entry, local_offset);
+
+			item.data = {};
+			item.packed = {};
+		};
+		impl::parallel_for_ordered(batch_.size(), pack, write);
+
+		batch_.clear();
+		batch_fill_ = 0;
+		return result;
+	}
+
+	bool writer::stream(member const& header, io::stream& source, size_t size) {
+		record entry{
+		    .header = &header,
+		    .crc = ::crc32(0, nullptr, 0),
+		    .deflated = level_ != 0,
+		    .streamed = true,
+		    .zip64 = needs_zip64(size),
+		    .compressed = 0,
+		    .size = size,
+		};
+
+		auto const local_offset = offset_;
+		if (!put_local(entry)) return false;
+
+		// deflated in blocks on the worker pool, as the source is read
+		std::unique_ptr<zlib::parallel_compressor> encoder{};
+		if (entry.deflated) {
+			encoder = std::make_unique<zlib::parallel_compressor>(
+			    level_, zlib::parallel_compressor::default_block_size,
+			    zlib::format::raw);
+			if (encoder->failed()) {
+				failed_ = true;
+				return false;
+			}
+		}
+
+		std::vector<std::byte> input(std::min(size, stream_chunk));
+		std::vector<std::byte> output(encoder ? stream_chunk : 0);
+		size_t read{};
+		while (true) {
+			auto const wanted = std::min(size - read, input.size());
+			auto const chunk = wanted ? source.read({input.data(), wanted}) : 0;
+			if (wanted && !chunk) {
+				failed_ = true;
+				return false;
+			}
+			read += chunk;
+
+			auto data = std::span<std::byte const>{input.data(), chunk};
+
+			if (!encoder) {
+				entry.crc = zlib::crc32_update(entry.crc, data);
+				if (!put(data)) return false;
+				entry.compressed += chunk;
+				if (read == size) break;
+				continue;
+			}
+
+			auto const mode = read == size ? base::flush_mode::finish
+			                               : base::flush_mode::none;
+			do {
+				auto const [produced, consumed] =
+				    encoder->compress(data, output, mode);
+				if (encoder->failed()) {
+					failed_ = true;
+					return false;
+				}
+				data = data.subspan(consumed);
+				if (!put({output.data(), produced})) return false;
+				entry.compressed += produced;
+			} while (!data.empty() || (mode == base::flush_mode::finish &&
+			                           !encoder->finished()));
+
+			if (mode == base::flush_mode::finish) {
+				entry.crc = encoder->crc();
+				break;
+			}
+		}
+
+		if (!entry.zip64 && entry.compressed >= max_32) {
+			// the estimate in needs_zip64() was wrong
+			failed_ = true;
+			return false;
+		}
+
+		std::vector<std::byte> descriptor{};
+		put_le(descriptor, descriptor_signature, 4);
+		put_le(descriptor, entry.crc, 4);
+		put_le(descriptor, entry.compressed, entry.zip64 ? 8 : 4);
+		put_le(descriptor, entry.size, entry.zip64 ? 8 : 4);
+		if (!put(descriptor)) return false;
+
+		put_central(entry, local_offset);
+		return true;
+	}
+
+	bool writer::put_local(record const& entry) {
+		auto const& name = entry.header->name;
+		auto const timestamp = has_timestamp(entry.header->mtime);
+		auto const [time, date] = dos_date_time(entry.header->mtime);
+
+		std::vector<std::byte> out{};
+		put_le(out, local_signature, 4);
+		put_le(out, entry.zip64 ? version_zip64 : version_default, 2);
+		put_le(out, flags_for(name, entry.streamed), 2);
+		put_le(out, entry.deflated ? method_deflate : method_store, 2);
+		put_le(out, time, 2);
+		put_le(out, date, 2);
+		if (entry.streamed) {
+			// the values follow the data, in the descriptor
+			put_le(out, 0, 4);
+			put_le(out, entry.zip64 ? max_32 : 0, 4);
+			put_le(out, entry.zip64 ? max_32 : 0, 4);
+		} else {
+			put_le(out, entry.crc, 4);
+			put_le(out, entry.zip64 ? max_32 : entry.compressed, 4);
+			put_le(out, entry.zip64 ? max_32 : entry.size, 4);
+		}
+		put_le(out, name.size(), 2);
+		put_le(out, (entry.zip64 ? 20u : 0u) + (timestamp ? 9u : 0u), 2);
+		put_string(out, name);
+		if (entry.zip64) {
+			put_le(out, zip64_extra_id, 2);
+			put_le(out, 16, 2);
+			put_le(out, entry.streamed ? 0 : entry.size, 8);
+			put_le(out, entry.streamed ? 0 : entry.compressed, 8);
+		}
+		if (timestamp) put_timestamp(out, entry.header->mtime);
+
+		return put(out);
+	}
+
+	void writer::put_central(record const& entry, size_t local_offset) {
+		auto const& name = entry.header->name;
+		auto const timestamp = has_timestamp(entry.header->mtime);
+		auto const [time, date] = dos_date_time(entry.header->mtime);
+
+		auto const big_size = entry.size >= max_32;
+		auto const big_compressed = entry.compressed >= max_32;
+		auto const big_offset = local_offset >= max_32;
+		auto const zip64_size =
+		    (big_size ? 8u : 0u) + (big_compressed ? 8u : 0u) +
+		    (big_offset ? 8u : 0u);
+		auto const version =
+		    zip64_size || entry.zip64 ? version_zip64 : version_default;
+
+		auto const& copied = entry.header->copied;
+		auto const made_by = copied ? (copied->system & 0xFFu) << 8
+		                            : made_by_unix;
+
+		auto& out = central_;
+		put_le(out, central_signature, 4);
+		put_le(out, made_by | version, 2);
+		put_le(out, version, 2);
+		put_le(out, flags_for(name, entry.streamed), 2);
+		put_le(out, entry.deflated ? method_deflate : method_store, 2);
+		put_le(out, time, 2);
+		put_le(out, date, 2);
+		put_le(out, entry.crc, 4);
+		put_le(out, std::min(entry.compressed, max_32), 4);
+		put_le(out, std::min(entry.size, max_32), 4);
+		put_le(out, name.size(), 2);
+		put_le(out, (zip64_size ? zip64_size + 4 : 0u) + (timestamp ? 9u : 0u),
+		       2);
+		put_le(out, 0, 2);
+		put_le(out, 0, 2);
+		put_le(out, 0, 2);
+		put_le(out,
+		       copied ? copied->external : external_attributes(*entry.header),
+		       4);
+		put_le(out, std::min(local_offset, max_32), 4);
+		put_string(out, name);
+		if (zip64_size) {
+			put_le(out, zip64_extra_id, 2);
+			put_le(out, zip64_size, 2);
+			if (big_size) put_le(out, entry.size, 8);
+			if (big_compressed) put_le(out, entry.compressed, 8);
+			if (big_offset) put_le(out, local_offset, 8);
+		}
+		if (timestamp) put_timestamp(out, entry.header->mtime);
+
+		++entries_;
+	}
+
+	bool writer::put(std::span<std::byte const> data) {
+		if (failed_ || !output_) return false;
+		if (data.empty()) return true;
+
+		if (output_->write(data) != data.size()) {
+			failed_ = true;
+			return false;
+		}
+		offset_ += data.size();
+		return true;
+	}
+}  // namespace arch::zip
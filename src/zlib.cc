@@ -2,14 +2,23 @@
 // This code is licensed under MIT license (see LICENSE for details)
 
 #include "arch/zlib.hh"
+#include <algorithm>
 #include <limits>
+#include <vector>
+#include "background.hh"
+#include "compress_impl.hh"
 #include "decompress_impl.hh"
+#include "inflate/backends.hh"
 
 namespace arch::impl {
 	template <>
 	struct stream_traits<z_stream> : stream_traits_base<z_stream> {
 		static inline int decompress(z_stream* stream) noexcept {
-			return inflate(stream, Z_SYNC_FLUSH);
+			return ::inflate(stream, Z_SYNC_FLUSH);
+		}
+
+		static inline int finish(z_stream* stream) noexcept {
+			return ::inflate(stream, Z_FINISH);
 		}
 
 		static inline constexpr bool ok(int ret) noexcept {
@@ -18,6 +27,19 @@ namespace arch::impl {
 		static inline constexpr bool stream_end(int ret) noexcept {
 			return ret == Z_STREAM_END;
 		}
+		static inline constexpr bool recoverable(int ret) noexcept {
+			return ret == Z_BUF_ERROR;
+		}
+	};
+
+	template <>
+	struct encoder_traits<z_stream> : stream_traits<z_stream> {
+		static inline int encode(z_stream* stream,
+		                         base::flush_mode mode) noexcept {
+			static constexpr int flush[] = {Z_NO_FLUSH, Z_SYNC_FLUSH,
+			                                Z_FINISH};
+			return ::deflate(stream, flush[static_cast<int>(mode)]);
+		}
 	};
 }  // namespace arch::impl
 
@@ -43,6 +65,233 @@ namespace arch::zlib {
 	std::pair<size_t, size_t> decompressor::decompress(
 	    std::span<std::byte> input,
 	    std::span<std::byte> output) {
-		return impl::decompress(input, output, z_);
+		return impl::decompress(input, output, z_, eof_, damaged_);
+	}
+
+	bool decompressor::reset() noexcept {
+		if (!is_initialised_ || inflateReset(&z_) != Z_OK) return false;
+		eof_ = false;
+		damaged_ = false;
+		return true;
+	}
+
+	compressor::compressor(int level, format container)
+	    : level_{level}, requested_level_{level} {
+		static constexpr int window_bits[] = {-MAX_WBITS, MAX_WBITS,
+		                                      MAX_WBITS + 16};
+		static constexpr int default_mem_level = 8;
+
+#if defined(__GNUC__) && (__GNUC__ >= 7)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#endif
+
+		auto const err = deflateInit2(
+		    &z_, level, Z_DEFLATED, window_bits[static_cast<int>(container)],
+		    default_mem_level, Z_DEFAULT_STRATEGY);
+		is_initialised_ = err == Z_OK;
+
+#if defined(__GNUC__) && (__GNUC__ >= 7)
+#pragma GCC diagnostic pop
+#endif
+		failed_ = !is_initialised_;
+	}
+
+	compressor::~compressor() {
+		if (is_initialised_) deflateEnd(&z_);
+	}
+
+	std::pair<size_t, size_t> compressor::compress(
+	    std::span<std::byte const> input,
+	    std::span<std::byte> output,
+	    base::flush_mode mode) {
+		if (failed_ || finished_) return {};
+
+		size_t flushed{};
+		if (requested_level_ != level_ && !output.empty()) {
+			// deflateParams() ends the current block with the old level,
+			// which needs some room in the output
+			auto const room = static_cast<uInt>(std::min(
+			    output.size(), size_t{std::numeric_limits<uInt>::max()}));
+			z_.next_in = nullptr;
+			z_.avail_in = 0;
+			z_.next_out = reinterpret_cast<Bytef*>(output.data());
+			z_.avail_out = room;
+			auto const ret =
+			    deflateParams(&z_, requested_level_, Z_DEFAULT_STRATEGY);
+			flushed = room - z_.avail_out;
+			if (ret == Z_OK)
+				level_ = requested_level_;
+			else if (ret != Z_BUF_ERROR) {
+				failed_ = true;
+				return {flushed, 0};
+			}
+			output = output.subspan(flushed);
+		}
+
+		auto const [produced, consumed] =
+		    impl::compress(input, output, z_, mode, finished_, failed_);
+		return {flushed + produced, consumed};
+	}
+
+	bool compressor::reset() noexcept {
+		if (!is_initialised_ || deflateReset(&z_) != Z_OK) return false;
+		finished_ = false;
+		failed_ = false;
+		return true;
+	}
+
+	bool compressor::set_level(int level) noexcept {
+		if (!is_initialised_ || level < Z_DEFAULT_COMPRESSION || level > 9)
+			return false;
+		requested_level_ = level;
+		return true;
+	}
+
+	namespace {
+		struct raw_inflater {
+			raw_inflater() {
+#if defined(__GNUC__) && (__GNUC__ >= 7)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#endif
+
+				is_initialised = inflateInit2(&z, -MAX_WBITS) == Z_OK;
+
+#if defined(__GNUC__) && (__GNUC__ >= 7)
+#pragma GCC diagnostic pop
+#endif
+			}
+
+			~raw_inflater() {
+				if (is_initialised) inflateEnd(&z);
+			}
+
+			bool is_initialised{false};
+			z_stream z{};
+		};
+	}  // namespace
+
+	unsigned long crc32_update(unsigned long crc,
+	                           std::span<std::byte const> data) noexcept {
+		static constexpr auto uint_max =
+		    static_cast<size_t>(std::numeric_limits<uInt>::max());
+
+		auto bytes = reinterpret_cast<Bytef const*>(data.data());
+		auto length = data.size();
+		while (length) {
+			auto const chunk = std::min(length, uint_max);
+			crc = ::crc32(crc, bytes, static_cast<uInt>(chunk));
+			length -= chunk;
+			bytes += chunk;
+		}
+		return crc;
+	}
+
+	struct crc32_check::state {
+		unsigned long crc{};
+		uint64_t size{};
+		base::verify_result result{base::verify_result::unchecked};
+		impl::background_lane lane{};
+
+		void start() noexcept {
+			crc = ::crc32(0, nullptr, 0);
+			size = 0;
+		}
+
+		void update(std::span<std::byte const> data) noexcept {
+			size += data.size();
+			crc = crc32_update(crc, data);
+		}
+
+		bool finish(uint32_t expected_crc, uint64_t expected_size) noexcept {
+			// gzip stores ISIZE modulo 2^32, zip stores full size
+			static constexpr uint64_t low32 = 0xffff'ffff;
+			auto const size_matches =
+			    expected_size > low32 ? size == expected_size
+			                          : (size & low32) == expected_size;
+			auto const matches = crc == expected_crc && size_matches;
+			if (!matches)
+				result = base::verify_result::damaged;
+			else if (result == base::verify_result::unchecked)
+				result = base::verify_result::valid;
+			return matches;
+		}
+	};
+
+	crc32_check::crc32_check(base::verify policy)
+	    : policy_{policy}, state_{std::make_shared<state>()} {
+		state_->start();
+	}
+
+	crc32_check::~crc32_check() = default;
+
+	void crc32_check::start() {
+		switch (policy_) {
+			case base::verify::trusted:
+				break;
+			case base::verify::background:
+				state_->lane.post([state = state_] { state->start(); });
+				break;
+			default:
+				state_->start();
+				break;
+		}
+	}
+
+	void crc32_check::update(std::span<std::byte const> data) {
+		switch (policy_) {
+			case base::verify::trusted:
+				break;
+			case base::verify::background:
+				state_->lane.post(
+				    [state = state_,
+				     copy = std::vector<std::byte>{data.begin(), data.end()}] {
+					    state->update(copy);
+				    });
+				break;
+			default:
+				state_->update(data);
+				break;
+		}
+	}
+
+	bool crc32_check::finish(uint32_t crc, uint64_t size) {
+		switch (policy_) {
+			case base::verify::trusted:
+				return true;
+			case base::verify::background:
+				state_->lane.post(
+				    [state = state_, crc, size] { state->finish(crc, size); });
+				return true;
+			case base::verify::at_end:
+				state_->finish(crc, size);
+				return true;
+			case base::verify::immediate:
+				break;
+		}
+		return state_->finish(crc, size);
+	}
+
+	base::verify_result crc32_check::result() {
+		if (policy_ == base::verify::background) state_->lane.drain();
+		return state_->result;
 	}
 }  // namespace arch::zlib
+
+namespace arch::inflate::impl {
+	bool zlib_decode_all(std::span<std::byte const> input,
+	                     std::span<std::byte> output,
+	                     size_t& used) {
+		// small members come in millions, keep the state (and its window)
+		// allocated between the calls
+		thread_local zlib::raw_inflater inflater{};
+		if (!inflater.is_initialised || inflateReset(&inflater.z) != Z_OK)
+			return false;
+
+		// zlib does not write to the input, it only misses the const
+		auto const writable = std::span{const_cast<std::byte*>(input.data()),
+		                                input.size()};
+		return arch::impl::decompress_all(writable, output, inflater.z, used);
+	}
+}  // namespace arch::inflate::impl
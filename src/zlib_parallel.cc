@@ -0,0 +1,238 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#include <algorithm>
+#include <cstring>
+#include "arch/zlib.hh"
+#include "parallel.hh"
+
+namespace arch::zlib {
+	namespace {
+		constexpr size_t dictionary_size = 32 * 1024;
+		// empty stored block, left by Z_SYNC_FLUSH, and a bit of slack
+		constexpr size_t flush_overhead = 16;
+
+		struct raw_deflater {
+			~raw_deflater() {
+				if (is_initialised) deflateEnd(&z);
+			}
+
+			bool prepare(int new_level) noexcept {
+				if (is_initialised && level == new_level)
+					return deflateReset(&z) == Z_OK;
+
+				if (is_initialised) deflateEnd(&z);
+				z = {};
+				level = new_level;
+
+#if defined(__GNUC__) && (__GNUC__ >= 7)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+#endif
+
+				static constexpr int default_mem_level = 8;
+				is_initialised =
+				    deflateInit2(&z, level, Z_DEFLATED, -MAX_WBITS,
+				                 default_mem_level, Z_DEFAULT_STRATEGY) == Z_OK;
+
+#if defined(__GNUC__) && (__GNUC__ >= 7)
+#pragma GCC diagnostic pop
+#endif
+
+				return is_initialised;
+			}
+
+			bool is_initialised{false};
+			int level{};
+			z_stream z{};
+		};
+
+		struct block {
+			std::span<std::byte const> dictionary{};
+			std::span<std::byte const> input{};
+			std::vector<std::byte> output{};
+			unsigned long crc{};
+			bool failed{};
+		};
+
+		void deflate_block(block& job, int level, bool last) {
+			thread_local raw_deflater local{};
+			if (!local.prepare(level)) {
+				job.failed = true;
+				return;
+			}
+
+			auto& z = local.z;
+			// deflate does not write to the input, it only misses the const
+			auto const input = const_cast<std::byte*>(job.input.data());
+
+			if (!job.dictionary.empty() &&
+			    deflateSetDictionary(
+			        &z, reinterpret_cast<Bytef const*>(job.dictionary.data()),
+			        static_cast<uInt>(job.dictionary.size())) != Z_OK) {
+				job.failed = true;
+				return;
+			}
+
+			job.output.resize(deflateBound(&z, job.input.size()) +
+			                  flush_overhead);
+			z.next_in = reinterpret_cast<Bytef*>(input);
+			z.avail_in = static_cast<uInt>(job.input.size());
+			z.next_out = reinterpret_cast<Bytef*>(job.output.data());
+			z.avail_out = static_cast<uInt>(job.output.size());
+
+			// the sync flush leaves the block byte-aligned and not final, so
+			// the blocks can simply be appended one after another
+			auto const ret = ::deflate(&z, last ? Z_FINISH : Z_SYNC_FLUSH);
+			if (ret != (last ? Z_STREAM_END : Z_OK) || z.avail_in) {
+				job.failed = true;
+				return;
+			}
+			job.output.resize(job.output.size() - z.avail_out);
+			job.crc = crc32_update(::crc32(0, nullptr, 0), job.input);
+		}
+
+		void append32(std::vector<std::byte>& out, unsigned long value) {
+			for (int shift = 0; shift < 32; shift += 8)
+				out.push_back(static_cast<std::byte>((value >> shift) & 0xFF));
+		}
+	}  // namespace
+
+	parallel_compressor::parallel_compressor(int level,
+	                                         size_t block_size,
+	                                         format container)
+	    : level_{level}
+	    , block_size_{std::clamp(block_size, size_t{dictionary_size},
+	                             size_t{64 * 1024 * 1024})}
+	    , batch_size_{block_size_ * impl::concurrency() * 2}
+	    , container_{container} {
+		reset();
+	}
+
+	parallel_compressor::~parallel_compressor() = default;
+
+	bool parallel_compressor::set_level(int level) noexcept {
+		if (level < Z_DEFAULT_COMPRESSION || level > 9) return false;
+		// taken by the next batch of blocks
+		level_ = level;
+		return true;
+	}
+
+	bool parallel_compressor::reset() noexcept {
+		static constexpr std::byte header[] = {
+		    std::byte{0x1f}, std::byte{0x8b}, std::byte{Z_DEFLATED},
+		    std::byte{0},    std::byte{0},    std::byte{0},
+		    std::byte{0},    std::byte{0},    std::byte{0},
+		    std::byte{3},
+		};
+
+		data_.clear();
+		window_ = 0;
+		queue_.clear();
+		if (container_ == format::gzip)
+			queue_.assign(std::begin(header), std::end(header));
+		queue_pos_ = 0;
+		crc_ = ::crc32(0, nullptr, 0);
+		size_ = 0;
+		finishing_ = false;
+		finished_ = false;
+		failed_ = container_ == format::zlib;
+		return !failed_;
+	}
+
+	std::pair<size_t, size_t> parallel_compressor::compress(
+	    std::span<std::byte const> input,
+	    std::span<std::byte> output,
+	    base::flush_mode mode) {
+		if (failed_ || finished_) return {};
+
+		size_t produced{}, consumed{};
+		while (true) {
+			produced += drain(output.subspan(produced));
+			if (produced == output.size() || failed_) break;
+
+			if (consumed < input.size()) {
+				auto const room = window_ + batch_size_ - data_.size();
+				auto const chunk = input.subspan(
+				    consumed, std::min(room, input.size() - consumed));
+				data_.insert(data_.end(), chunk.begin(), chunk.end());
+				consumed += chunk.size();
+				if (data_.size() == window_ + batch_size_) encode_batch(false);
+				continue;
+			}
+
+			if (mode == base::flush_mode::none) break;
+
+			if (mode == base::flush_mode::finish) {
+				if (!finishing_) {
+					encode_batch(true);
+					if (container_ == format::gzip) {
+						append32(queue_, crc_);
+						append32(queue_, size_ & 0xFFFF'FFFF);
+					}
+					finishing_ = true;
+					continue;
+				}
+				finished_ = queue_pos_ == queue_.size();
+				break;
+			}
+
+			// sync flush
+			if (data_.size() > window_) {
+				encode_batch(false);
+				continue;
+			}
+			break;
+		}
+
+		return {produced, consumed};
+	}
+
+	void parallel_compressor::encode_batch(bool last) {
+		auto const pending = data_.size() - window_;
+		auto const count = std::max(size_t{1},
+		                            (pending + block_size_ - 1) / block_size_);
+
+		std::vector<block> blocks(count);
+		for (size_t index = 0; index < count; ++index) {
+			auto const start = window_ + index * block_size_;
+			auto const length = std::min(block_size_, data_.size() - start);
+			auto const dictionary = std::min(start, dictionary_size);
+			auto& job = blocks[index];
+			job.dictionary = {data_.data() + start - dictionary, dictionary};
+			job.input = {data_.data() + start, length};
+		}
+
+		impl::parallel_for(count, [&](size_t index) {
+			deflate_block(blocks[index], level_, last && index == count - 1);
+		});
+
+		for (auto const& job : blocks) {
+			if (job.failed) {
+				failed_ = true;
+				return;
+			}
+			queue_.insert(queue_.end(), job.output.begin(), job.output.end());
+			crc_ = ::crc32_combine(crc_, job.crc,
+			                       static_cast<z_off_t>(job.input.size()));
+			size_ += job.input.size();
+		}
+
+		// keep the tail of this batch as the dictionary of the next one
+		auto const keep = std::min(data_.size(), dictionary_size);
+		data_.erase(data_.begin(),
+		            data_.end() - static_cast<ptrdiff_t>(keep));
+		window_ = keep;
+	}
+
+	size_t parallel_compressor::drain(std::span<std::byte> output) {
+		auto const chunk = std::min(output.size(), queue_.size() - queue_pos_);
+		if (chunk) std::memcpy(output.data(), queue_.data() + queue_pos_, chunk);
+		queue_pos_ += chunk;
+		if (queue_pos_ == queue_.size()) {
+			queue_.clear();
+			queue_pos_ = 0;
+		}
+		return chunk;
+	}
+}  // namespace arch::zlib
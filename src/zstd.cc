@@ -0,0 +1,80 @@
+// Copyright (c) 2020 midnightBITS
+// This code is licensed under MIT license (see LICENSE for details)
+
+#define ZSTD_STATIC_LINKING_ONLY
+#include "arch/zstd.hh"
+#include "decompress_impl.hh"
+
+namespace arch::impl {
+	template <>
+	struct stream_traits<zstd::stream> : stream_traits_base<zstd::stream> {
+		static inline size_t decompress(zstd::stream* stream) noexcept {
+			ZSTD_inBuffer in{stream->next_in, stream->avail_in, 0};
+			ZSTD_outBuffer out{stream->next_out, stream->avail_out, 0};
+
+			auto const ret = ZSTD_decompressStream(stream->ctx, &out, &in);
+
+			stream->next_in += in.pos;
+			stream->avail_in -= in.pos;
+			stream->next_out += out.pos;
+			stream->avail_out -= out.pos;
+			stream->pending = ZSTD_isError(ret) ? 0 : ret;
+			return ret;
+		}
+
+		// anything but 0 means the frame is not flushed yet, and the rest of
+		// a block taken in whole may be waiting in the context
+		static inline bool pending(zstd::stream const& stream) noexcept {
+			return stream.pending != 0;
+		}
+
+		// a frame (or a skippable frame) was decoded and flushed completely
+		static inline bool stream_end(size_t ret) noexcept { return !ret; }
+
+		static inline bool ok(size_t ret) noexcept {
+			return !ZSTD_isError(ret);
+		}
+	};
+}  // namespace arch::impl
+
+namespace arch::zstd {
+	decompressor::decompressor(base::verify policy) {
+		zs_.ctx = ZSTD_createDCtx();
+		if (!zs_.ctx) return;
+
+		// the library's limit for the window stays: 128MiB, enough for
+		// the default --long; frames asking for more are not decoded, so a
+		// small file cannot make us allocate gigabytes
+
+#ifdef ZSTD_d_forceIgnoreChecksum
+		if (policy == base::verify::trusted)
+			ZSTD_DCtx_setParameter(zs_.ctx, ZSTD_d_forceIgnoreChecksum,
+			                       ZSTD_d_ignoreChecksum);
+#else
+		(void)policy;
+#endif
+	}
+
+	decompressor::~decompressor() { ZSTD_freeDCtx(zs_.ctx); }
+
+	std::pair<size_t, size_t> decompressor::decompress(
+	    std::span<std::byte> input,
+	    std::span<std::byte> output) {
+		if (!zs_.ctx) {
+			damaged_ = true;
+			return {};
+		}
+		return impl::decompress(input, output, zs_, eof_, damaged_);
+	}
+
+	bool decompressor::reset() noexcept {
+		// the parameters survive session-only resets
+		if (!zs_.ctx ||
+		    ZSTD_isError(ZSTD_DCtx_reset(zs_.ctx, ZSTD_reset_session_only)))
+			return false;
+		zs_.pending = 0;
+		eof_ = false;
+		damaged_ = false;
+		return true;
+	}
+}  // namespace arch::zstd